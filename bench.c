@@ -0,0 +1,740 @@
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "spacewar_bot.h"
+#include "spacewar_bullets.h"
+#include "spacewar_grid.h"
+#include "spacewar_net.h"
+#include "spacewar_profile.h"
+#include "spacewar_replay.h"
+#include "spacewar_sim.h"
+
+// Microbenchmarks of the simulation's hot loops, built as spacewar_bench.
+// Every case is timed over a few runs and reported as the mean and standard
+// deviation of nanoseconds per operation, and operations per second. With
+// --csv that is one CSV row per case, for comparing builds by script.
+
+// Bullets and ships are split between two teams, like in a team match
+#define BENCH_TEAM_COUNT 2
+#define BENCH_RUN_COUNT 5
+// Ticks a simulation case steps before going back to its starting state, so
+// bullets never run out
+#define BENCH_SIM_CHUNK_TICKS 8
+
+static bool bench_csv;
+
+static double GetWallTime(void)
+{
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static uint32_t NextRandom(uint32_t *state)
+{
+    // xorshift32
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static float RandomRange(uint32_t *state, float min, float max)
+{
+    return min + (NextRandom(state) >> 8) / 16777216.0f * (max - min);
+}
+
+// printf for the human readable report, nothing with --csv
+static void BenchPrintHeading(const char *format, ...)
+{
+    if (bench_csv) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    putchar('\n');
+}
+
+// Reports one case: what was timed, at how many entities, what one operation
+// is, and the nanoseconds per operation of each run
+static void BenchPrint(const char *benchmark, const char *variant, int count,
+                       const char *op, const double *ns_per_op)
+{
+    double mean = 0.0;
+    for (int run = 0; run < BENCH_RUN_COUNT; run++) {
+        mean += ns_per_op[run] / BENCH_RUN_COUNT;
+    }
+    double variance = 0.0;
+    for (int run = 0; run < BENCH_RUN_COUNT; run++) {
+        double deviation = ns_per_op[run] - mean;
+        variance += deviation * deviation / (BENCH_RUN_COUNT - 1);
+    }
+    double stddev = sqrt(variance);
+    double ops_per_second = mean > 0.0 ? 1e9 / mean : 0.0;
+    double relative_stddev = mean > 0.0 ? stddev * 100.0 / mean : 0.0;
+    if (bench_csv) {
+        printf("%s,%s,%d,%s,%d,%.3f,%.3f,%.0f\n", benchmark, variant, count,
+               op, BENCH_RUN_COUNT, mean, stddev, ops_per_second);
+    } else {
+        printf("  %-9s %6d: %12.2f ns/%-6s +-%5.1f%% %14.0f %s/s\n",
+               variant, count, mean, op, relative_stddev, ops_per_second, op);
+    }
+}
+
+// Owners take turns between owner_count ships
+static void BulletPoolFillRandom(BulletPool *pool, int count, int owner_count,
+                                 uint32_t seed)
+{
+    for (int i = 0; i < count; i++) {
+        pool->x[i] = RandomRange(&seed, 0.0f, SCREEN_WIDTH - BULLET_WIDTH);
+        pool->y[i] = RandomRange(&seed, 0.0f, SCREEN_HEIGHT);
+        pool->prev_x[i] = pool->x[i];
+        pool->direction[i] = (NextRandom(&seed) & 1) ? 1.0f : -1.0f;
+        pool->owner[i] = i % owner_count;
+    }
+    pool->count = count;
+}
+
+// Bullets shared by every ship of the match, each ship counting its own like
+// SimStep does when it spawns them, so hits and bullets leaving the arena
+// take the counts back down to 0 and never below
+static void SimFillRandomBullets(SimState *sim, int count, uint32_t seed)
+{
+    int ship_count = sim->setup.ship_count;
+    BulletPoolFillRandom(&sim->bullets, count, ship_count, seed);
+    for (int i = 0; i < ship_count; i++) {
+        sim->ships[i].bullet_count =
+            count / ship_count + (i < count % ship_count);
+    }
+}
+
+// Moves count bullets back and forth so none leaves the arena, for each run
+// fills in nanoseconds per bullet
+static void BenchBulletKernel(BulletPool *pool, BulletKernel kernel,
+                              int count, double *ns_per_op)
+{
+    const float distance = BULLET_VELOCITY / SIM_DEFAULT_TICK_RATE;
+    const int tick_count = 100000000 / count + 10;
+    pool->kernel = kernel;
+    BulletPoolFillRandom(pool, count, BENCH_TEAM_COUNT, 1);
+
+    for (int run = 0; run < BENCH_RUN_COUNT; run++) {
+        double start = GetWallTime();
+        for (int tick = 0; tick < tick_count; tick++) {
+            BulletPoolIntegrate(pool, (tick & 1) ? -distance : distance,
+                                -BULLET_WIDTH - SCREEN_WIDTH,
+                                2.0f * SCREEN_WIDTH);
+        }
+        double elapsed = GetWallTime() - start;
+        ns_per_op[run] = elapsed * 1e9 / ((double)count * tick_count);
+    }
+}
+
+// Runs every kernel on the same bullets and checks they agree bit for bit
+static bool CheckBulletKernels(BulletPool *pools, int count)
+{
+    const float distance = BULLET_VELOCITY / SIM_DEFAULT_TICK_RATE;
+    for (int kernel = 0; kernel < BULLET_KERNEL_COUNT; kernel++) {
+        if (!BulletKernelSupported(kernel)) {
+            continue;
+        }
+        BulletPool *pool = &pools[kernel];
+        pool->kernel = kernel;
+        BulletPoolFillRandom(pool, count, BENCH_TEAM_COUNT, 7);
+        for (int tick = 0; tick < 60; tick++) {
+            BulletPoolIntegrate(pool, distance, -BULLET_WIDTH, SCREEN_WIDTH);
+        }
+
+        const BulletPool *scalar = &pools[BULLET_KERNEL_SCALAR];
+        size_t size = count * sizeof(float);
+        if (0 != memcmp(pool->x, scalar->x, size) ||
+            0 != memcmp(pool->swept_x, scalar->swept_x, size) ||
+            0 != memcmp(pool->swept_width, scalar->swept_width, size) ||
+            0 != memcmp(pool->removals, scalar->removals,
+                        (count + BULLET_REMOVAL_GROUP - 1) /
+                            BULLET_REMOVAL_GROUP)) {
+            fprintf(stderr, "%s kernel disagrees with the scalar one\n",
+                    BulletKernelGetName(kernel));
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool BenchBulletKernels(void)
+{
+    const int counts[] = {1000, 100000};
+    const int capacity = 100000;
+    BulletPool pools[BULLET_KERNEL_COUNT];
+    for (int i = 0; i < BULLET_KERNEL_COUNT; i++) {
+        if (!BulletPoolInit(&pools[i], capacity)) {
+            fprintf(stderr, "Not enough memory for %d bullets\n", capacity);
+            return false;
+        }
+    }
+
+    bool agree = CheckBulletKernels(pools, capacity);
+    BenchPrintHeading("Bullet integrate and cull, best kernel %s",
+                      BulletKernelGetName(BulletKernelDetect()));
+    for (int i = 0; agree && i < (int)(sizeof(counts) / sizeof(counts[0]));
+         i++) {
+        for (int kernel = 0; kernel < BULLET_KERNEL_COUNT; kernel++) {
+            if (BulletKernelSupported(kernel)) {
+                double ns_per_op[BENCH_RUN_COUNT];
+                BenchBulletKernel(&pools[0], kernel, counts[i], ns_per_op);
+                BenchPrint("bullet_integrate", BulletKernelGetName(kernel),
+                           counts[i], "bullet", ns_per_op);
+            }
+        }
+    }
+
+    for (int i = 0; i < BULLET_KERNEL_COUNT; i++) {
+        BulletPoolDeinit(&pools[i]);
+    }
+    return agree;
+}
+
+static bool CheckOverlap(Rectangle a, Rectangle b)
+{
+    return a.x < b.x + b.width && a.x + a.width > b.x && a.y < b.y + b.height &&
+           a.y + a.height > b.y;
+}
+
+// Hits of bullets on the ships of the other team, found by testing every
+// pair, the way the simulation did before it had a grid
+static int CountHitsBruteForce(const BulletPool *pool, const Ship *ships,
+                               int ship_count)
+{
+    int hit_count = 0;
+    for (int target = 0; target < ship_count; target++) {
+        Rectangle hitbox = ShipGetHitbox(&ships[target]);
+        for (int i = 0; i < pool->count; i++) {
+            hit_count += pool->owner[i] != target % BENCH_TEAM_COUNT &&
+                         CheckOverlap(BulletPoolGetCollisionRectangle(pool, i),
+                                      hitbox);
+        }
+    }
+    return hit_count;
+}
+
+static int CountHitsGrid(SpatialGrid *grid, const BulletPool *pool,
+                         const Ship *ships, int ship_count)
+{
+    SpatialGridClear(grid);
+    for (int i = 0; i < pool->count; i++) {
+        SpatialGridAdd(grid, pool->swept_x[i], pool->y[i],
+                       pool->swept_width[i], BULLET_HEIGHT, i);
+    }
+    SpatialGridBuild(grid);
+
+    int hit_count = 0;
+    for (int target = 0; target < ship_count; target++) {
+        Rectangle hitbox = ShipGetHitbox(&ships[target]);
+        SpatialGridQuery query = SpatialGridQueryCreate(
+            grid, hitbox.x, hitbox.y, hitbox.width, hitbox.height);
+        GridEntry entry;
+        while (SpatialGridQueryNext(&query, &entry)) {
+            int i = entry.index;
+            hit_count += pool->owner[i] != target % BENCH_TEAM_COUNT &&
+                         CheckOverlap(BulletPoolGetCollisionRectangle(pool, i),
+                                      hitbox);
+        }
+    }
+    return hit_count;
+}
+
+// Nanoseconds per tick of finding every bullet to ship hit, by brute force
+// and with the grid, for a few bullet and ship counts
+static bool BenchBroadPhase(void)
+{
+    const int bullet_counts[] = {16, 64, 1000, 10000, 50000};
+    const int ship_counts[] = {2, 16, 48};
+    const int capacity = 50000;
+    const char *const methods[] = {"brute", "grid"};
+    BulletPool pool;
+    SpatialGrid grid;
+    Ship ships[48];
+    const int max_ships = sizeof(ships) / sizeof(ships[0]);
+    if (!BulletPoolInit(&pool, capacity) ||
+        !SpatialGridInit(&grid, SCREEN_WIDTH, SCREEN_HEIGHT,
+                         SIM_GRID_CELL_SIZE) ||
+        !SpatialGridReserve(&grid, capacity)) {
+        fprintf(stderr, "Not enough memory for %d bullets\n", capacity);
+        return false;
+    }
+    uint32_t seed = 3;
+    for (int i = 0; i < max_ships; i++) {
+        float x = RandomRange(&seed, 0, SCREEN_WIDTH - SHIP_WIDTH);
+        float y = RandomRange(&seed, 0, SCREEN_HEIGHT - SHIP_HEIGHT);
+        ships[i] = (Ship){.position = {x, y}};
+    }
+
+    bool agree = true;
+    BenchPrintHeading("Bullet to ship collisions by method/ships and bullets");
+    for (size_t b = 0; b < sizeof(bullet_counts) / sizeof(bullet_counts[0]);
+         b++) {
+        int bullet_count = bullet_counts[b];
+        BulletPoolFillRandom(&pool, bullet_count, BENCH_TEAM_COUNT, 5);
+        BulletPoolIntegrate(&pool, BULLET_VELOCITY / SIM_DEFAULT_TICK_RATE,
+                            -INFINITY, INFINITY);
+        for (size_t s = 0; s < sizeof(ship_counts) / sizeof(ship_counts[0]);
+             s++) {
+            int ship_count = ship_counts[s];
+            const int tick_count =
+                20000000 / (bullet_count * ship_count * BENCH_RUN_COUNT) + 10;
+            int hits[2];
+            for (int method = 0; method < 2; method++) {
+                double ns_per_op[BENCH_RUN_COUNT];
+                for (int run = 0; run < BENCH_RUN_COUNT; run++) {
+                    double start = GetWallTime();
+                    for (int tick = 0; tick < tick_count; tick++) {
+                        hits[method] =
+                            method ? CountHitsGrid(&grid, &pool, ships,
+                                                   ship_count)
+                                   : CountHitsBruteForce(&pool, ships,
+                                                         ship_count);
+                    }
+                    ns_per_op[run] =
+                        (GetWallTime() - start) * 1e9 / tick_count;
+                }
+                char variant[16];
+                snprintf(variant, sizeof(variant), "%s/%d", methods[method],
+                         ship_count);
+                BenchPrint("collisions", variant, bullet_count, "tick",
+                           ns_per_op);
+            }
+            if (hits[0] != hits[1]) {
+                fprintf(stderr, "Grid found %d hits instead of %d\n", hits[1],
+                        hits[0]);
+                agree = false;
+            }
+        }
+    }
+
+    BulletPoolDeinit(&pool);
+    SpatialGridDeinit(&grid);
+    return agree;
+}
+
+// Steps start for tick_count ticks per run with the same inputs for every
+// ship, going back to start every few ticks, and fills in nanoseconds per
+// tick divided by per_tick
+static void BenchSimStep(SimState *sim, const SimSnapshot *start,
+                         const InputMask inputs[2], int tick_count,
+                         int per_tick, double *ns_per_op)
+{
+    const float deltatime = 1.0f / SIM_DEFAULT_TICK_RATE;
+    InputMask ship_inputs[2][SIM_MAX_SHIPS];
+    for (int i = 0; i < SIM_MAX_SHIPS; i++) {
+        ship_inputs[0][i] = inputs[0];
+        ship_inputs[1][i] = inputs[1];
+    }
+    for (int run = 0; run < BENCH_RUN_COUNT; run++) {
+        double elapsed = 0.0;
+        // Whole chunks, so this may step a few more ticks than asked for
+        int tick = 0;
+        for (; tick < tick_count; tick += BENCH_SIM_CHUNK_TICKS) {
+            SimLoadSnapshot(sim, start);
+            double chunk_start = GetWallTime();
+            for (int i = 0; i < BENCH_SIM_CHUNK_TICKS; i++) {
+                SimStep(sim, ship_inputs[i & 1], deltatime);
+            }
+            elapsed += GetWallTime() - chunk_start;
+        }
+        ns_per_op[run] = elapsed * 1e9 / tick / per_tick;
+    }
+}
+
+// A whole SimStep with many bullets in flight between 16 idle ships, which
+// is mostly bullet movement and collisions
+static bool BenchSimBullets(void)
+{
+    const int bullet_counts[] = {48, 1000, 10000};
+    const int capacity = 10000;
+    const SimSetup setup = {SIM_MAX_SHIPS, SIM_MODE_FREE_FOR_ALL};
+    SimState sim;
+    SimSnapshot start;
+    if (!SimInit(&sim, capacity) || !SimInit(&start, capacity)) {
+        fprintf(stderr, "Not enough memory for %d bullets\n", capacity);
+        return false;
+    }
+
+    BenchPrintHeading("Simulation step with bullets between %d ships",
+                      setup.ship_count);
+    const InputMask idle[2] = {0, 0};
+    for (size_t b = 0; b < sizeof(bullet_counts) / sizeof(bullet_counts[0]);
+         b++) {
+        SimReset(&start, setup, 1);
+        for (int i = 0; i < setup.ship_count; i++) {
+            // Hits only take bullets away, nobody wins
+            start.ships[i].health = INT32_MAX;
+        }
+        SimFillRandomBullets(&start, bullet_counts[b], 9);
+        double ns_per_op[BENCH_RUN_COUNT];
+        BenchSimStep(&sim, &start, idle,
+                     1000000 / (bullet_counts[b] + 100), 1, ns_per_op);
+        BenchPrint("sim_step_bullets", "ffa", bullet_counts[b], "tick",
+                   ns_per_op);
+    }
+
+    SimDeinit(&sim);
+    SimDeinit(&start);
+    return true;
+}
+
+// A whole SimStep of ships moving and shooting on every other tick, which is
+// mostly ship movement, bounds and spawning bullets
+static bool BenchSimShips(void)
+{
+    const int ship_counts[] = {2, 8, 16};
+    SimState sim;
+    SimSnapshot start;
+    if (!SimInit(&sim, SIM_DEFAULT_BULLET_CAPACITY) ||
+        !SimInit(&start, SIM_DEFAULT_BULLET_CAPACITY)) {
+        fprintf(stderr, "Not enough memory for the match\n");
+        return false;
+    }
+
+    BenchPrintHeading("Simulation step with ships moving and shooting");
+    const InputMask inputs[2] = {INPUT_UP | INPUT_RIGHT | INPUT_SHOOT,
+                                 INPUT_DOWN | INPUT_LEFT};
+    for (int mode = 0; mode < SIM_MODE_COUNT; mode++) {
+        for (size_t s = 0; s < sizeof(ship_counts) / sizeof(ship_counts[0]);
+             s++) {
+            SimReset(&start, (SimSetup){ship_counts[s], mode}, 1);
+            double ns_per_op[BENCH_RUN_COUNT];
+            BenchSimStep(&sim, &start, inputs, 100000, ship_counts[s],
+                         ns_per_op);
+            BenchPrint("sim_step_ships", SimModeGetName(mode), ship_counts[s],
+                       "ship", ns_per_op);
+        }
+    }
+
+    SimDeinit(&sim);
+    SimDeinit(&start);
+    return true;
+}
+
+// The tick PlayingStateUpdate runs, bots sampling their input and the
+// simulation stepping, over whole matches where every ship is a hard bot
+static bool BenchBrawl(void)
+{
+    const int ship_counts[] = {2, 8, 16};
+    const int match_count = 4;
+    SimState sim;
+    if (!SimInit(&sim, SIM_DEFAULT_BULLET_CAPACITY)) {
+        fprintf(stderr, "Not enough memory for the match\n");
+        return false;
+    }
+    BotInputSource bots[SIM_MAX_SHIPS];
+    InputSource *sources[SIM_MAX_SHIPS];
+
+    BenchPrintHeading("Bot brawls, input and simulation step");
+    for (int mode = 0; mode < SIM_MODE_COUNT; mode++) {
+        for (size_t s = 0; s < sizeof(ship_counts) / sizeof(ship_counts[0]);
+             s++) {
+            SimSetup setup = {ship_counts[s], mode};
+            double ns_per_op[BENCH_RUN_COUNT];
+            for (int run = 0; run < BENCH_RUN_COUNT; run++) {
+                uint64_t ticks = 0;
+                double start = GetWallTime();
+                for (int match = 0; match < match_count; match++) {
+                    for (int i = 0; i < SIM_MAX_SHIPS; i++) {
+                        bots[i] = BotInputSourceCreate(BOT_HARD,
+                                                       SIM_DEFAULT_TICK_RATE);
+                        sources[i] = &bots[i].source;
+                    }
+                    SimReset(&sim, setup, match + 1);
+                    while (NONE == sim.winner &&
+                           sim.tick < SIM_DEFAULT_TICK_RATE * 300) {
+                        InputMask inputs[SIM_MAX_SHIPS];
+                        InputSourcesSample(sources, &sim, inputs);
+                        SimStep(&sim, inputs, 1.0f / SIM_DEFAULT_TICK_RATE);
+                    }
+                    ticks += sim.tick;
+                }
+                ns_per_op[run] = (GetWallTime() - start) * 1e9 / ticks;
+            }
+            BenchPrint("brawl_tick", SimModeGetName(mode), setup.ship_count,
+                       "tick", ns_per_op);
+        }
+    }
+
+    SimDeinit(&sim);
+    return true;
+}
+
+// Network conditions the rollback case plays over, like --loopback ones
+typedef struct {
+    const char *name;
+    double latency;
+    double jitter;
+    float loss;
+} BenchNetwork;
+
+// One side of a loopback match, a hard bot playing through its own session
+typedef struct {
+    RollbackSession session;
+    SimState sim;
+    BotInputSource bot;
+    ReplayWriter replay_writer;
+    char replay_path[64];
+} BenchPeer;
+
+// Time spent in RollbackSessionStep, apart for the steps that rolled back
+typedef struct {
+    double plain_time;
+    double rollback_time;
+    uint64_t plain_steps;
+    uint64_t rollback_steps;
+    uint64_t resimulated_ticks;
+} BenchRollbackTimes;
+
+// Ticks of a rollback match, both replays have to agree on all of them
+#define BENCH_ROLLBACK_TICKS (SIM_DEFAULT_TICK_RATE * 60)
+
+static bool BenchPeerInit(BenchPeer *peer, LoopbackNetwork *network,
+                          int player, uint32_t seed)
+{
+    snprintf(peer->replay_path, sizeof(peer->replay_path),
+             "spacewar_bench_rollback_%d.swr", player);
+    remove(peer->replay_path);
+    peer->replay_writer = (ReplayWriter){0};
+    peer->bot = BotInputSourceCreate(BOT_HARD, SIM_DEFAULT_TICK_RATE);
+    if (!SimInit(&peer->sim, SIM_DEFAULT_BULLET_CAPACITY)) {
+        return false;
+    }
+    if (!RollbackSessionInit(&peer->session,
+                             &network->ends[player].transport, player,
+                             SIM_DEFAULT_TICK_RATE, seed,
+                             SIM_DEFAULT_BULLET_CAPACITY)) {
+        SimDeinit(&peer->sim);
+        return false;
+    }
+    return true;
+}
+
+static void BenchPeerDeinit(BenchPeer *peer)
+{
+    ReplayWriterClose(&peer->replay_writer);
+    remove(peer->replay_path);
+    RollbackSessionDeinit(&peer->session);
+    SimDeinit(&peer->sim);
+}
+
+// Runs one tick of peer like NetPlayPrepareTick and NetPlayStep do, starting
+// the match and its replay once the peers agree on it, and adds the step to
+// times
+static bool BenchPeerStep(BenchPeer *peer, BenchRollbackTimes *times)
+{
+    RollbackSession *session = &peer->session;
+    bool running = ROLLBACK_RUNNING == session->status;
+    if (!RollbackSessionPoll(session, &peer->sim)) {
+        return true;
+    }
+    if (!running) {
+        SimReset(&peer->sim, SIM_DUEL_SETUP, session->seed);
+        for (int i = 0; i < SIM_DUEL_SETUP.ship_count; i++) {
+            // Nobody wins, so the bots keep changing their inputs
+            peer->sim.ships[i].health = INT32_MAX;
+        }
+        ReplayHeader header =
+            ReplayHeaderCreate(&peer->sim, SIM_DEFAULT_TICK_RATE);
+        if (!ReplayWriterOpen(&peer->replay_writer, peer->replay_path,
+                              header)) {
+            fprintf(stderr, "Could not record replay to %s\n",
+                    peer->replay_path);
+            return false;
+        }
+        session->replay_writer = &peer->replay_writer;
+    }
+
+    int player = session->local_player;
+    InputMask input =
+        peer->bot.source.Sample(&peer->bot.source, &peer->sim, player);
+    SimEvents events;
+    double start = GetWallTime();
+    RollbackSessionStep(session, &peer->sim, input,
+                        1.0f / SIM_DEFAULT_TICK_RATE, &events);
+    double elapsed = GetWallTime() - start;
+    if (session->last_rollback_ticks > 0) {
+        times->rollback_time += elapsed;
+        times->rollback_steps++;
+        times->resimulated_ticks += session->last_rollback_ticks;
+    } else {
+        times->plain_time += elapsed;
+        times->plain_steps++;
+    }
+    return true;
+}
+
+// Whether both replays start the same and agree on the first tick_count ticks
+static bool BenchReplaysAgree(const BenchPeer peers[2], uint32_t tick_count)
+{
+    Replay replays[2];
+    if (!ReplayOpen(&replays[0], peers[0].replay_path)) {
+        return false;
+    }
+    if (!ReplayOpen(&replays[1], peers[1].replay_path)) {
+        ReplayClose(&replays[0]);
+        return false;
+    }
+    const ReplayHeader *headers[2] = {&replays[0].header, &replays[1].header};
+    bool agree = headers[0]->seed == headers[1]->seed &&
+                 headers[0]->player_count == headers[1]->player_count &&
+                 headers[0]->mode == headers[1]->mode;
+    ReplayCursor cursors[2] = {ReplayCursorCreate(&replays[0]),
+                               ReplayCursorCreate(&replays[1])};
+    for (uint32_t tick = 0; agree && tick < tick_count; tick++) {
+        InputMask inputs[2][SIM_MAX_SHIPS];
+        agree = ReplayCursorNext(&cursors[0], inputs[0]) &&
+                ReplayCursorNext(&cursors[1], inputs[1]) &&
+                0 == memcmp(inputs[0], inputs[1], sizeof(inputs[0]));
+    }
+    ReplayClose(&replays[0]);
+    ReplayClose(&replays[1]);
+    return agree;
+}
+
+// Plays a bot match between two sessions over network and fills in the
+// nanoseconds each re-simulated tick added to the steps that rolled back
+static bool BenchRollbackMatch(const BenchNetwork *network_conditions,
+                               uint32_t seed, double *ns_per_tick)
+{
+    LoopbackNetwork network;
+    LoopbackNetworkInit(&network, network_conditions->latency,
+                        network_conditions->jitter, network_conditions->loss,
+                        seed);
+    BenchPeer peers[2];
+    if (!BenchPeerInit(&peers[0], &network, 0, seed)) {
+        fprintf(stderr, "Not enough memory for the match\n");
+        return false;
+    }
+    if (!BenchPeerInit(&peers[1], &network, 1, 0)) {
+        fprintf(stderr, "Not enough memory for the match\n");
+        BenchPeerDeinit(&peers[0]);
+        return false;
+    }
+
+    BenchRollbackTimes times = {0};
+    bool ok = true;
+    // Stalls wait for the peer, give them plenty of room before giving up
+    for (int i = 0; ok && i < BENCH_ROLLBACK_TICKS * 4; i++) {
+        if (peers[0].session.recorded_tick >= BENCH_ROLLBACK_TICKS &&
+            peers[1].session.recorded_tick >= BENCH_ROLLBACK_TICKS) {
+            break;
+        }
+        LoopbackNetworkAdvance(&network, 1.0 / SIM_DEFAULT_TICK_RATE);
+        for (int p = 1; ok && p >= 0; p--) {
+            ok = BenchPeerStep(&peers[p], &times);
+        }
+    }
+
+    for (int p = 0; p < 2; p++) {
+        ReplayWriterClose(&peers[p].replay_writer);
+        if (ok && peers[p].session.recorded_tick < BENCH_ROLLBACK_TICKS) {
+            fprintf(stderr, "Rollback over %s: player %d stalled at tick %u\n",
+                    network_conditions->name, p + 1,
+                    (unsigned)peers[p].session.recorded_tick);
+            ok = false;
+        }
+    }
+    if (ok && !BenchReplaysAgree(peers, BENCH_ROLLBACK_TICKS)) {
+        fprintf(stderr, "Rollback over %s: the peers' replays differ\n",
+                network_conditions->name);
+        ok = false;
+    }
+
+    // A step that rolls back does what a plain one does, plus loading a
+    // snapshot and re-simulating
+    double plain_step =
+        times.plain_steps ? times.plain_time / times.plain_steps : 0.0;
+    double resimulation_time =
+        times.rollback_time - times.rollback_steps * plain_step;
+    *ns_per_tick = times.resimulated_ticks
+                       ? resimulation_time * 1e9 / times.resimulated_ticks
+                       : 0.0;
+    BenchPeerDeinit(&peers[0]);
+    BenchPeerDeinit(&peers[1]);
+    return ok;
+}
+
+// Two sessions playing each other over a lossy loopback network, which also
+// checks they record the same replay
+static bool BenchRollback(void)
+{
+    const BenchNetwork networks[] = {
+        {"50ms-10%", 0.05, 0.01, 0.1f},
+        {"100ms-30%", 0.1, 0.02, 0.3f},
+    };
+    BenchPrintHeading("Rollback re-simulation, %d ticks at most",
+                      ROLLBACK_DEFAULT_MAX_TICKS);
+    bool ok = true;
+    for (size_t n = 0; n < sizeof(networks) / sizeof(networks[0]); n++) {
+        double ns_per_op[BENCH_RUN_COUNT];
+        for (int run = 0; ok && run < BENCH_RUN_COUNT; run++) {
+            ok = BenchRollbackMatch(&networks[n], run + 1, &ns_per_op[run]);
+        }
+        if (!ok) {
+            break;
+        }
+        BenchPrint("rollback_resim", networks[n].name,
+                   ROLLBACK_DEFAULT_MAX_TICKS, "tick", ns_per_op);
+    }
+    return ok;
+}
+
+#ifdef SPACEWAR_PROFILE
+// Nothing but zones. Without SPACEWAR_PROFILE there is nothing to time, the
+// case is left out.
+static bool BenchProfileZone(void)
+{
+    const int zone_count = 2000000;
+    BenchPrintHeading("Profiling zone");
+    double ns_per_op[BENCH_RUN_COUNT];
+    for (int run = 0; run < BENCH_RUN_COUNT; run++) {
+        double start = GetWallTime();
+        for (int i = 0; i < zone_count; i++) {
+            PROFILE_BEGIN(BenchZone);
+            PROFILE_END(BenchZone);
+        }
+        ns_per_op[run] = (GetWallTime() - start) * 1e9 / zone_count;
+    }
+    ProfileShutdown();
+    BenchPrint("profile_zone", "on", 1, "zone", ns_per_op);
+    return true;
+}
+#endif /* ifdef SPACEWAR_PROFILE */
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "--csv")) {
+            bench_csv = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--csv]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (bench_csv) {
+        printf("benchmark,variant,count,op,runs,ns_per_op,stddev_ns,"
+               "ops_per_second\n");
+    }
+
+    bool ok = BenchBulletKernels();
+    ok = BenchBroadPhase() && ok;
+    ok = BenchSimBullets() && ok;
+    ok = BenchSimShips() && ok;
+    ok = BenchBrawl() && ok;
+    ok = BenchRollback() && ok;
+#ifdef SPACEWAR_PROFILE
+    ok = BenchProfileZone() && ok;
+#endif
+    return ok ? 0 : 1;
+}
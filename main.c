@@ -3,15 +3,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "raylib.h"
 #include "raymath.h"
 #include "rlgl.h"
 
+#include "spacewar_archive.h"
+#include "spacewar_audio_thread.h"
+#include "spacewar_batch.h"
+#include "spacewar_bot.h"
+#include "spacewar_frame_stats.h"
+#include "spacewar_input.h"
+#include "spacewar_net.h"
+#include "spacewar_profile.h"
+#include "spacewar_replay.h"
+#include "spacewar_sim.h"
+#include "spacewar_soak.h"
+
 // #define DRAW_HITBOX
 
-#define MAX_PLAYER_BULLETS 3
-#define MAX_POOL_BULLETS (MAX_PLAYER_BULLETS * 2)
 #define LEFT_SHIP_TEXTURE_FILEPATH "assets/red-spaceship.png"
 #define LEFT_SHIP_GLOW_TEXTURE_FILEPATH "assets/red-spaceship-glow.png"
 #define RIGHT_SHIP_TEXTURE_FILEPATH "assets/blue-spaceship.png"
@@ -22,8 +33,54 @@
 #define PAUSE_SFX_FILEPATH "assets/pause-sfx.wav"
 #define CLICK_SFX_FILEPATH "assets/click-sfx.wav"
 #define BACKGROUND_MUSIC_FILEPATH "assets/background-music.ogg"
+// Of the background music, to size its buffer in frames
+#define MUSIC_SAMPLE_RATE 48000
+// Music decoded ahead of playback, unless --music-buffer says otherwise
+#define DEFAULT_MUSIC_BUFFER_MS 200
 #define PAUSE_ICON_FILEPATH "assets/pause-icon.png"
 #define WINDOW_ICON_FILEPATH "assets/window-icon.png"
+#define REPLAYS_DIRECTORY "replays"
+// Replays started within the same second get -2, -3 and so on, up to this
+#define REPLAY_MAX_NAME_TRIES 100
+// Where F4 writes the profiling zones without --trace
+#define DEFAULT_TRACE_FILENAME "spacewar-trace.json"
+// Built by spacewar_pack and looked for next to the executable
+#define ASSET_ARCHIVE_FILENAME "assets.swpak"
+// Built with -DEMBED_ASSETS the archive is compiled into the executable from
+// the C source spacewar_pack --c-source writes, and no file is opened
+#ifdef EMBED_ASSETS
+extern const unsigned char EMBEDDED_ASSETS[];
+extern const size_t EMBEDDED_ASSETS_SIZE;
+#endif
+// Red and blue ships, each turned to face right and left
+#define SHIP_COLOR_COUNT 2
+// Ships past the keyboards are played by bots
+#define KEYBOARD_COUNT 2
+// Width of the texture every sprite and the font are packed into
+#define SPRITE_ATLAS_WIDTH 512
+// Empty texels around each sprite, so neighbours never bleed in
+#define SPRITE_ATLAS_PADDING 1
+#define SPRITE_ATLAS_MAX_SPRITES 16
+// Distinct strings laid out at once, enough for every label and health value
+#define TEXT_CACHE_CAPACITY 256
+// Twice the capacity, so lookups stay short
+#define TEXT_CACHE_SLOT_COUNT 512
+#define TEXT_CACHE_MAX_LENGTH 24
+// Quads of the busiest frame with room to spare: every bullet, each ship's
+// sprite, glow and label, and 256 glyphs of text over them
+#define RENDER_BATCH_ELEMENTS \
+    (MAX_POOL_BULLETS + SIM_MAX_SHIPS * (2 + TEXT_CACHE_MAX_LENGTH) + 256)
+// Frames the frame time HUD graphs, two pixels wide each
+#define FRAME_HUD_GRAPH_FRAMES 180
+// Copies of each sound effect that can play over each other
+#define SOUND_VOICES_PER_EFFECT 4
+// Voices of all effects mixed at once, past which new ones take over old ones
+#define SOUND_MAX_ACTIVE_VOICES 8
+// How much faster than real time --soak plays its matches
+#define SOAK_PLAYBACK_SPEED 32.0f
+// Matches bots have not won by then are left for the main menu
+#define SOAK_MAX_MATCH_SECONDS 300
+#define SOAK_PROGRESS_CYCLES 100
 
 typedef struct {
     int move_up;
@@ -35,34 +92,15 @@ typedef struct {
 } ShipKeyMap;
 
 typedef struct {
-    Vector2 position;
+    InputSource source;
     ShipKeyMap key_map;
-    bool left_side;
-    int bullet_count;
-    Texture2D texture;
-    int health;
-    Texture2D glow_texture;
-    Vector2 last_direction;
-    float dash_time;
-    float dash_cooldown;
-    enum { DEFAULT, DASHING } state;
-} Ship;
-
-typedef struct {
-    Vector2 position;
-    Vector2 last_position;
-    bool active;
-    Ship *owner;
-} Bullet;
-
-typedef enum {
-    NONE,
-    LEFT,
-    RIGHT,
-    DRAW,
-} Winner;
-
-typedef Bullet BulletPool[MAX_POOL_BULLETS];
+    InputMask held;
+    // Presses seen since the last sample, so a tap shorter than a tick still
+    // reaches the simulation
+    InputMask latched;
+    // What the last sample returned
+    InputMask sampled;
+} KeyboardInputSource;
 
 typedef struct {
     Vector2 center;
@@ -77,7 +115,8 @@ typedef struct {
     Vector2 center;
     Vector2 padding;
     float scale;
-    Texture2D texture;
+    // Area of the sprite atlas
+    Rectangle sprite;
 } TextureButton;
 
 typedef struct {
@@ -114,18 +153,195 @@ typedef struct {
     WinGui win_gui;
 } Gui;
 
+// Every image the game draws, packed into one texture so a frame is drawn
+// without switching textures. Shapes are drawn with its white texels and
+// text with a copy of the default font whose glyphs are in it too.
+typedef struct {
+    Texture2D texture;
+    Font font;
+    Rectangle white;
+} SpriteAtlas;
+
+// Size and glyph positions of a string, measured once and drawn from then on
+typedef struct {
+    char string[TEXT_CACHE_MAX_LENGTH];
+    unsigned int font_id;
+    float font_size;
+    float spacing;
+    Vector2 size;
+    // Spaces take room but draw nothing, so they have no glyph
+    int glyph_count;
+    int codepoints[TEXT_CACHE_MAX_LENGTH];
+    float glyph_x[TEXT_CACHE_MAX_LENGTH];
+} TextLayout;
+
+// Layouts stay where they were added until the cache is cleared with the
+// font, keyed by string, font, size and spacing
+typedef struct {
+    TextLayout layouts[TEXT_CACHE_CAPACITY];
+    int count;
+    // Index of a layout plus one, 0 when empty
+    short slots[TEXT_CACHE_SLOT_COUNT];
+} TextCache;
+
+// What the UI layer shows, compared each frame to tell when to redraw it
+typedef struct {
+    bool has_health;
+    int health[2];
+    const char *net_status;
+} UiLayerContent;
+
+// The HUD over the gameplay, kept in a texture of its own and only redrawn
+// when what it shows changes, then drawn in one blit every frame
+typedef struct {
+    RenderTexture2D texture;
+    bool drawn;
+    UiLayerContent content;
+} UiLayer;
+
+typedef enum {
+    SOUND_EFFECT_SHOOT,
+    SOUND_EFFECT_HIT,
+    SOUND_EFFECT_WIN,
+    SOUND_EFFECT_PAUSE,
+    SOUND_EFFECT_CLICK,
+    SOUND_EFFECT_COUNT,
+} SoundEffect;
+
+// The loaded sound and aliases sharing its samples, so a shot no longer cuts
+// off the one before it
+typedef struct {
+    int voice_count;
+    Sound voices[SOUND_VOICES_PER_EFFECT];
+    // The voice started longest ago, taken over first
+    int next;
+    // The tick it last started a voice, it starts at most one per tick
+    unsigned played_tick;
+    bool played;
+} SoundEffectVoices;
+
+typedef struct {
+    int active_voices;
+    int peak_voices;
+    // Voices cut off to start another one
+    int stolen;
+    // Plays folded into one already started this tick
+    int merged;
+    // Plays skipped because all voices were busy with other effects
+    int dropped;
+} SoundPoolStats;
+
+typedef struct {
+    SoundEffectVoices effects[SOUND_EFFECT_COUNT];
+    unsigned tick;
+    SoundPoolStats stats;
+} SoundPool;
+
+// Frame times shown over the window with F3
+typedef struct {
+    bool shown;
+    FrameStats stats;
+    // Recomputed a few times a second, so the numbers stay readable
+    FrameSummary summary;
+    double summary_time;
+    SoundPoolStats sounds;
+} FrameHud;
+
+// Textures and sounds loaded right now, counted by every load and unload so
+// --soak notices when they pile up
+typedef struct {
+    int textures;
+    int sounds;
+} LiveResources;
+
+// With --soak the game plays itself: every ship is a bot and a script clicks
+// the buttons, going from the main menu to a match it pauses and resumes,
+// then to a rematch it pauses and leaves for the main menu, over and over
+typedef struct {
+    bool active;
+    int cycle_count;
+    int cycle;
+    // Progress through the current cycle
+    bool paused;
+    bool rematch;
+    // Where the script clicks this frame, instead of the mouse
+    bool clicking;
+    Vector2 click;
+    double frame_time_sum;
+    int frame_count;
+    SoakLog log;
+} Soak;
+
+// Where assets are read from: the archive compiled into the executable or
+// next to it when there is one, loose files under the working directory
+// otherwise. Assets are named by their *_FILEPATH in all of them.
+typedef struct {
+    bool has_archive;
+    Archive archive;
+} AssetSource;
+
+// Sprites and sounds, kept apart from the simulation state so that state
+// stays plain data. They are decoded and uploaded once by GameLoadResources
+// and only read afterwards, so a rematch never touches the disk or the GPU.
 typedef struct {
-    Ship ship1;
-    Ship ship2;
-    BulletPool bullet_pool;
-    Winner winner;
-
-    Sound shoot_sfx;
-    Sound hit_sfx;
-    Sound win_sfx;
-    Sound pause_sfx;
-    Sound click_sfx;
+    bool loaded;
+    // Kept open while the music streams from it
+    AssetSource assets;
+    // Areas of the sprite atlas, indexed by color, then by whether the ship
+    // faces right
+    Rectangle ship_sprites[SHIP_COLOR_COUNT][2];
+    Rectangle ship_glow_sprites[SHIP_COLOR_COUNT][2];
+    Rectangle pause_icon_sprite;
+
+    SoundPool sounds;
     Music background_music;
+    // Decodes the music and refills its buffer, the main loop never does.
+    // Take its lock before touching the music.
+    AudioThread *music_thread;
+    // Without it, PlayingStateUpdate refills the buffer as it used to
+    bool music_thread_failed;
+} GameResources;
+
+typedef struct {
+    RollbackSession session;
+    UdpTransport udp;
+    // With --loopback the remote player runs in this process too, on the
+    // second keyboard, behind a simulated network
+    bool loopback;
+    LoopbackNetwork network;
+    RollbackSession peer_session;
+    SimState peer_sim;
+} NetPlay;
+
+typedef struct {
+    SimState sim;
+    SimSetup setup;
+    int tick_rate;
+    // Unsimulated time left over from previous frames, always less than a tick
+    float tick_accumulator;
+
+    KeyboardInputSource keyboards[KEYBOARD_COUNT];
+    InputSource *input_sources[SIM_MAX_SHIPS];
+    // With --bot a bot plays the second ship as well
+    bool has_bot;
+    BotDifficulty bot_difficulty;
+    BotInputSource bots[SIM_MAX_SHIPS];
+    ReplayWriter replay_writer;
+    // Only mapped when watching a replay instead of playing
+    Replay replay;
+    ReplayInputSource replay_source;
+    float playback_speed;
+    // Only set when playing over the network
+    NetPlay *net;
+    // Snapshot taken by the quick save key
+    SimSnapshot quick_save;
+    bool has_quick_save;
+    // Seconds spent polling the keyboards this frame, for the frame time HUD
+    double input_time;
+    // Seconds of music decoded ahead of playback
+    float music_buffer_time;
+
+    GameResources resources;
 
     Gui gui;
 } Game;
@@ -136,28 +352,25 @@ typedef struct GameState {
     void (*Draw)(const Game *game);
 } GameState;
 
-const int SCREEN_WIDTH = 480;
-const int SCREEN_HEIGHT = 270;
 const Vector2 SCREEN_HALF = {SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f};
 const int INITIAL_SCREEN_SCALE = 2;
 const int INITIAL_WINDOW_WIDTH = SCREEN_WIDTH * INITIAL_SCREEN_SCALE;
 const int INITIAL_WINDOW_HEIGHT = SCREEN_HEIGHT * INITIAL_SCREEN_SCALE;
 
-const int SHIP_WIDTH = 24;
-const int SHIP_HEIGHT = 26;
-const float SHIP_VELOCITY = 180.0f;
-const int SHIP_HITBOX_WIDTH = 14;
-const int SHIP_HITBOX_HEIGHT = 20;
-const int SHIP_INITIAL_HEALTH = 3;
 const int SHIP_HEALTH_X_OFF = 10;
 const int SHIP_HEALTH_Y_OFF = 10;
-const float SHIP_DASH_DURATION = 0.07f;
-const float SHIP_DASH_SPEED = 1000.0f;
-const float SHIP_DASH_COOLDOWN = 5.0f;
+const float SHIP_LABEL_FONT_SIZE = 10.0f;
+
+// Longest frame time fed to the simulation, so a long hitch does not make the
+// game spend the next frames catching up
+const float MAX_FRAME_TIME = 0.25f;
 
-const int BULLET_WIDTH = 12;
-const int BULLET_HEIGHT = 1;
-const float BULLET_VELOCITY = 600.0f;
+// Seconds of frames the frame time HUD summarizes, and how often
+const float FRAME_HUD_WINDOW = 5.0f;
+const double FRAME_HUD_REFRESH_TIME = 0.25;
+const float FRAME_HUD_GRAPH_HEIGHT = 100.0f;
+// Frame time at the top of the graph
+const float FRAME_HUD_GRAPH_MAX_TIME = 1.0f / 30.0f;
 
 const float WIN_FONT_SIZE = 64.0f;
 const float DEFAULT_LETTER_SPACING = 1.0f;
@@ -168,6 +381,21 @@ GameState playing_state;
 GameState pause_state;
 GameState win_state;
 
+SpriteAtlas sprite_atlas;
+TextCache text_cache;
+UiLayer ui_layer;
+// The last gameplay frame, with the pause or win overlay's unchanging parts
+// drawn over it once when entering those states
+RenderTexture2D frozen_frame;
+FrameHud frame_hud;
+// A batch of our own, so its draw calls can be counted before it is drawn
+rlRenderBatch render_batch;
+// Draw calls made into the screen this frame, added up before every flush,
+// which forgets them
+int frame_draw_calls;
+LiveResources live_resources;
+Soak soak;
+
 Vector2 GetMousePositionOnScreen(void)
 {
     Vector2 mouse = GetMousePosition();
@@ -182,20 +410,147 @@ Rectangle CreateRectangleFromCenter(float centerx, float centery, float width,
                        height};
 }
 
+unsigned int TextCacheHash(const char *string, float font_size, float spacing)
+{
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for (const char *c = string; '\0' != *c; c++) {
+        hash = (hash ^ (unsigned char)*c) * 16777619u;
+    }
+    return hash ^ (unsigned int)(font_size * 64.0f) * 2654435761u ^
+           (unsigned int)(spacing * 64.0f) * 40503u;
+}
+
+// Places glyphs the way DrawTextEx and MeasureTextEx do, for one line
+void TextLayoutInit(TextLayout *layout, Font font, const char *string,
+                    float font_size, float spacing)
+{
+    *layout = (TextLayout){.font_id = font.texture.id,
+                           .font_size = font_size,
+                           .spacing = spacing};
+    strcpy(layout->string, string);
+    float scale = font_size / font.baseSize;
+    float x = 0.0f;
+    int codepoint_count = 0;
+    for (const char *c = string; '\0' != *c;) {
+        int codepoint_size = 0;
+        int codepoint = GetCodepointNext(c, &codepoint_size);
+        int index = GetGlyphIndex(font, codepoint);
+        if (' ' != codepoint && '\t' != codepoint) {
+            layout->codepoints[layout->glyph_count] = codepoint;
+            layout->glyph_x[layout->glyph_count] = x;
+            layout->glyph_count++;
+        }
+        float advance = 0 != font.glyphs[index].advanceX
+                            ? font.glyphs[index].advanceX
+                            : font.recs[index].width;
+        x += advance * scale + spacing;
+        codepoint_count++;
+        c += codepoint_size;
+    }
+    float width = 0 < codepoint_count ? x - spacing : 0.0f;
+    layout->size = (Vector2){width, font_size};
+}
+
+// The layout of string in the sprite atlas font, measured on first use.
+// NULL for strings too long to cache, or once the cache is full.
+const TextLayout *TextCacheGet(const char *string, float font_size,
+                               float spacing)
+{
+    TextCache *cache = &text_cache;
+    unsigned int font_id = sprite_atlas.font.texture.id;
+    if (strlen(string) >= TEXT_CACHE_MAX_LENGTH ||
+        NULL != strchr(string, '\n')) {
+        return NULL;
+    }
+    unsigned int slot = TextCacheHash(string, font_size, spacing) %
+                        TEXT_CACHE_SLOT_COUNT;
+    for (; 0 != cache->slots[slot]; slot = (slot + 1) % TEXT_CACHE_SLOT_COUNT) {
+        const TextLayout *layout = &cache->layouts[cache->slots[slot] - 1];
+        if (font_id == layout->font_id && font_size == layout->font_size &&
+            spacing == layout->spacing && 0 == strcmp(string, layout->string)) {
+            return layout;
+        }
+    }
+    if (TEXT_CACHE_CAPACITY == cache->count) {
+        return NULL;
+    }
+    TextLayout *layout = &cache->layouts[cache->count++];
+    TextLayoutInit(layout, sprite_atlas.font, string, font_size, spacing);
+    cache->slots[slot] = cache->count;
+    return layout;
+}
+
+void TextCacheClear(TextCache *cache)
+{
+    cache->count = 0;
+    memset(cache->slots, 0, sizeof(cache->slots));
+}
+
+Vector2 MeasureCachedText(const char *string, float font_size, float spacing)
+{
+    const TextLayout *layout = TextCacheGet(string, font_size, spacing);
+    return NULL != layout
+               ? layout->size
+               : MeasureTextEx(sprite_atlas.font, string, font_size, spacing);
+}
+
+void DrawTextLayout(const TextLayout *layout, Vector2 position, Color color)
+{
+    for (int i = 0; i < layout->glyph_count; i++) {
+        Vector2 glyph_position = {position.x + layout->glyph_x[i], position.y};
+        DrawTextCodepoint(sprite_atlas.font, layout->codepoints[i],
+                          glyph_position, layout->font_size, color);
+    }
+}
+
+void DrawCachedText(const char *string, Vector2 position, float font_size,
+                    float spacing, Color color)
+{
+    const TextLayout *layout = TextCacheGet(string, font_size, spacing);
+    if (NULL != layout) {
+        DrawTextLayout(layout, position, color);
+    } else {
+        DrawTextEx(sprite_atlas.font, string, position, font_size, spacing,
+                   color);
+    }
+}
+
+// DrawText and MeasureText with the font of the sprite atlas, spaced the
+// way Raylib spaces its default font
+void DrawAtlasText(const char *string, int x, int y, int font_size,
+                   Color color)
+{
+    DrawCachedText(string, (Vector2){x, y}, font_size, font_size / 10, color);
+}
+
+int MeasureAtlasText(const char *string, int font_size)
+{
+    return MeasureCachedText(string, font_size, font_size / 10).x;
+}
+
 void DrawTextCenter(const char *string, Vector2 center, float font_size,
                     float letter_spacing, Color color)
 {
+    const TextLayout *layout = TextCacheGet(string, font_size, letter_spacing);
     Vector2 text_size =
-        MeasureTextEx(GetFontDefault(), string, font_size, letter_spacing);
+        NULL != layout
+            ? layout->size
+            : MeasureTextEx(sprite_atlas.font, string, font_size,
+                            letter_spacing);
     Vector2 topleft = Vector2Subtract(center, Vector2Scale(text_size, 0.5f));
-    DrawTextEx(GetFontDefault(), string, topleft, font_size, letter_spacing,
-               color);
+    if (NULL != layout) {
+        DrawTextLayout(layout, topleft, color);
+    } else {
+        DrawTextEx(sprite_atlas.font, string, topleft, font_size,
+                   letter_spacing, color);
+    }
 }
 
 Rectangle GetTextButtonRectangle(const TextButton *button)
 {
-    Vector2 size = MeasureTextEx(GetFontDefault(), button->text,
-                                 button->font_size, DEFAULT_LETTER_SPACING);
+    Vector2 size = MeasureCachedText(button->text, button->font_size,
+                                     DEFAULT_LETTER_SPACING);
     // Times 2 for 2 direction padding
     Vector2 extra = Vector2Scale(button->padding, 2.0f);
     size = Vector2Add(size, extra);
@@ -206,7 +561,7 @@ Rectangle GetTextButtonRectangle(const TextButton *button)
 
 Rectangle GetTextureButtonRectangle(const TextureButton *button)
 {
-    Vector2 size = {button->texture.width, button->texture.height};
+    Vector2 size = {button->sprite.width, button->sprite.height};
     // Times 2 for 2 direction padding
     Vector2 extra = Vector2Scale(button->padding, 2.0f);
     size = Vector2Add(size, extra);
@@ -242,11 +597,15 @@ void DrawTextButton(const TextButton *button)
 
 void DrawTextureButton(const TextureButton *button)
 {
-    Vector2 offset = {button->texture.width, button->texture.height};
+    Vector2 offset = {button->sprite.width, button->sprite.height};
     offset = Vector2Scale(offset, 0.5f * button->scale);
     Vector2 topleft = button->center;
     topleft = Vector2Subtract(topleft, offset);
-    DrawTextureEx(button->texture, topleft, 0.0f, button->scale, WHITE);
+    Rectangle destination = {topleft.x, topleft.y,
+                             button->sprite.width * button->scale,
+                             button->sprite.height * button->scale};
+    DrawTexturePro(sprite_atlas.texture, button->sprite, destination,
+                   (Vector2){0, 0}, 0.0f, WHITE);
 }
 
 void DrawButton(const Button *button)
@@ -270,6 +629,9 @@ void DrawButton(const Button *button)
 
 bool RectangleCheckPressed(Rectangle rectangle)
 {
+    if (soak.active) {
+        return soak.clicking && CheckCollisionPointRec(soak.click, rectangle);
+    }
     return IsMouseButtonPressed(MOUSE_LEFT_BUTTON) &&
            CheckCollisionPointRec(GetMousePositionOnScreen(), rectangle);
 }
@@ -287,249 +649,460 @@ bool ButtonCheckPressed(const Button *button)
     return pressed;
 }
 
-Rectangle ShipGetHitbox(const Ship *ship)
+void BulletPoolDraw(const BulletPool *bullets, float alpha)
 {
-    return (Rectangle){
-        ship->position.x + SHIP_WIDTH / 2.0f - SHIP_HITBOX_WIDTH / 2.0f,
-        ship->position.y + SHIP_HEIGHT / 2.0f - SHIP_HITBOX_HEIGHT / 2.0f,
-        SHIP_HITBOX_WIDTH, SHIP_HITBOX_HEIGHT};
+    for (int i = 0; i < bullets->count; i++) {
+        Vector2 position = {Lerp(bullets->prev_x[i], bullets->x[i], alpha),
+                            bullets->y[i]};
+        DrawRectangleV(position, (Vector2){BULLET_WIDTH, BULLET_HEIGHT},
+                       RAYWHITE);
+    }
 }
 
-void BulletPoolAddBullet(BulletPool bullet_pool, Ship *owner)
+// Reads the keyboard, meant to be called once per frame
+void KeyboardInputSourcePoll(KeyboardInputSource *keyboard)
 {
-    Bullet *bullet = 0;
-    for (int i = 0; i < MAX_POOL_BULLETS; i++) {
-        if (!bullet_pool[i].active) {
-            bullet = &bullet_pool[i];
-            break;
-        }
-    }
+    const ShipKeyMap *key_map = &keyboard->key_map;
+    InputMask held = 0;
+    held |= IsKeyDown(key_map->move_up) ? INPUT_UP : 0;
+    held |= IsKeyDown(key_map->move_down) ? INPUT_DOWN : 0;
+    held |= IsKeyDown(key_map->move_left) ? INPUT_LEFT : 0;
+    held |= IsKeyDown(key_map->move_right) ? INPUT_RIGHT : 0;
+    held |= IsKeyDown(key_map->shoot) ? INPUT_SHOOT : 0;
+    held |= IsKeyDown(key_map->dash) ? INPUT_DASH : 0;
+    keyboard->held = held;
+
+    keyboard->latched |= IsKeyPressed(key_map->shoot) ? INPUT_SHOOT : 0;
+    keyboard->latched |= IsKeyPressed(key_map->dash) ? INPUT_DASH : 0;
+}
 
-    assert(0 != bullet);
+InputMask KeyboardInputSourceSample(InputSource *source, const SimState *sim,
+                                    int player)
+{
+    (void)sim;
+    (void)player;
+    KeyboardInputSource *keyboard = (KeyboardInputSource *)source;
+    InputMask input = keyboard->held | keyboard->latched;
+    // A key released and pressed again since the last sample looks held all
+    // along, so it is released for this tick and pressed on the next one, or
+    // the simulation would miss the press
+    InputMask pressed_again = keyboard->latched & keyboard->sampled;
+    input &= ~pressed_again;
+    keyboard->latched = pressed_again;
+    keyboard->sampled = input;
+    return input;
+}
 
-    bullet->active = true;
-    bullet->position.x = (owner->left_side) ? owner->position.x + SHIP_WIDTH
-                                            : owner->position.x - BULLET_WIDTH;
-    bullet->position.y =
-        owner->position.y + SHIP_HEIGHT / 2.0f - BULLET_HEIGHT / 2.0f;
-    bullet->last_position = bullet->position;
-    bullet->owner = owner;
+KeyboardInputSource KeyboardInputSourceCreate(ShipKeyMap key_map)
+{
+    return (KeyboardInputSource){
+        .source = {.Sample = &KeyboardInputSourceSample}, .key_map = key_map};
 }
 
-void BulletDeactivate(Bullet *bullet)
+bool GameIsReplaying(const Game *game)
 {
-    bullet->active = false;
-    bullet->owner->bullet_count--;
+    return NULL != game->replay.file.data;
 }
 
-void BulletPoolUpdateMovement(BulletPool bullet_pool, float deltatime)
+float GameGetTickDuration(const Game *game) { return 1.0f / game->tick_rate; }
+
+// How far rendering is between the previous and the current tick
+float GameGetTickAlpha(const Game *game)
 {
-    for (int i = 0; i < MAX_POOL_BULLETS; i++) {
-        Bullet *bullet = &bullet_pool[i];
-        if (!bullet->active) {
-            continue;
-        }
+    return game->tick_accumulator / GameGetTickDuration(game);
+}
 
-        bullet->last_position = bullet->position;
-        bullet->position.x +=
-            BULLET_VELOCITY * deltatime * (bullet->owner->left_side ? 1 : -1);
+void ShipDrawGlow(Vector2 position, Rectangle sprite, Rectangle glow_sprite)
+{
+    Vector2 center = RectangleGetCenter(
+        (Rectangle){position.x, position.y, sprite.width, sprite.height});
+    Rectangle rectangle = CreateRectangleFromCenter(
+        center.x, center.y, glow_sprite.width, glow_sprite.height);
+    DrawTextureRec(sprite_atlas.texture, glow_sprite,
+                   (Vector2){roundf(rectangle.x), roundf(rectangle.y)}, WHITE);
+}
 
-        if (bullet->owner->left_side && bullet->position.x > SCREEN_WIDTH) {
-            BulletDeactivate(bullet);
-        } else if (!bullet->owner->left_side &&
-                   bullet->position.x < -BULLET_WIDTH) {
-            BulletDeactivate(bullet);
-        }
+void ShipDraw(const Ship *ship, float alpha, Rectangle sprite,
+              Rectangle glow_sprite)
+{
+    Vector2 position = Vector2Lerp(ship->last_position, ship->position, alpha);
+    DrawTextureRec(sprite_atlas.texture, sprite, position, WHITE);
+    if (ship->dash_cooldown <= 0) {
+        ShipDrawGlow(position, sprite, glow_sprite);
     }
+
+#ifdef DRAW_HITBOX
+    DrawRectangleLinesEx(ShipGetHitbox(ship), 1.0f, RED);
+#endif // NHITBOX
 }
 
-void BulletPoolDraw(const BulletPool bullet_pool)
+void ShipDrawHealth(const Ship *ship)
 {
-    for (int i = 0; i < MAX_POOL_BULLETS; i++) {
-        const Bullet *bullet = &bullet_pool[i];
-        if (!bullet->active) {
-            continue;
-        }
+    char health_str[10];
+    sprintf(health_str, "%d", ship->health);
+    int health_width = MeasureAtlasText(health_str, 24);
+    int health_x = LEFT == ship->team
+                       ? SHIP_HEALTH_X_OFF
+                       : SCREEN_WIDTH - health_width - SHIP_HEALTH_X_OFF;
+    DrawAtlasText(health_str, health_x, SHIP_HEALTH_Y_OFF, 24, RAYWHITE);
+}
 
-        DrawRectangleV(bullet->position, (Vector2){BULLET_WIDTH, BULLET_HEIGHT},
-                       RAYWHITE);
+// Health above the ship when there are too many for the corners, led by the
+// ship's number in free for all
+void ShipDrawLabel(const Ship *ship, int index, SimMode mode, float alpha)
+{
+    char label[16];
+    if (SIM_MODE_FREE_FOR_ALL == mode) {
+        sprintf(label, "P%d %d", index + 1, ship->health);
+    } else {
+        sprintf(label, "%d", ship->health);
+    }
+    Vector2 position = Vector2Lerp(ship->last_position, ship->position, alpha);
+    DrawTextCenter(
+        label, (Vector2){position.x + SHIP_WIDTH / 2.0f, position.y - 6.0f},
+        SHIP_LABEL_FONT_SIZE, DEFAULT_LETTER_SPACING, RAYWHITE);
+}
+
+bool AssetSourceOpen(AssetSource *assets)
+{
+#ifdef EMBED_ASSETS
+    assets->has_archive = ArchiveOpenMemory(&assets->archive, EMBEDDED_ASSETS,
+                                            EMBEDDED_ASSETS_SIZE);
+#else
+    const char *path =
+        TextFormat("%s%s", GetApplicationDirectory(), ASSET_ARCHIVE_FILENAME);
+    assets->has_archive = ArchiveOpen(&assets->archive, path);
+#endif
+    return assets->has_archive;
+}
+
+const char *AssetSourceGetName(const AssetSource *assets)
+{
+    if (!assets->has_archive) {
+        return "loose files";
     }
+#ifdef EMBED_ASSETS
+    return "embedded data";
+#else
+    return ASSET_ARCHIVE_FILENAME;
+#endif
 }
 
-// Returns bullet's collision rectangle based on its movement
-Rectangle BulletGetCollisionRectangle(const Bullet *bullet)
+void AssetSourceClose(AssetSource *assets)
 {
-    float x = fmin(bullet->position.x, bullet->last_position.x);
-    float dx = fabs(bullet->position.x - bullet->last_position.x);
-    // Bullet only move horizontally
-    float y = bullet->position.y;
-    float dy = BULLET_HEIGHT;
-    Rectangle collision_rectangle = {x, y, dx, dy};
-    return collision_rectangle;
+    ArchiveClose(&assets->archive);
+    assets->has_archive = false;
 }
 
-int BulletPoolHandleCollisions(BulletPool bullet_pool, const Ship *shooter,
-                               const Ship *target)
+// Bytes of the asset in the archive, NULL if it has to be loaded from disk
+const unsigned char *AssetSourceFind(const AssetSource *assets,
+                                     const char *path, int *size)
 {
-    int collision_count = 0;
-    for (int i = 0; i < MAX_POOL_BULLETS; i++) {
-        Bullet *bullet = &bullet_pool[i];
-        if (!bullet->active || bullet->owner != shooter) {
-            continue;
-        }
+    size_t found_size = 0;
+    const unsigned char *data =
+        assets->has_archive ? ArchiveFind(&assets->archive, path, &found_size)
+                            : NULL;
+    *size = found_size;
+    return data;
+}
 
-        if (!CheckCollisionRecs(BulletGetCollisionRectangle(bullet),
-                                ShipGetHitbox(target))) {
-            continue;
-        }
+Texture2D LoadTextureCounted(Image image)
+{
+    Texture2D texture = LoadTextureFromImage(image);
+    live_resources.textures += IsTextureValid(texture);
+    return texture;
+}
 
-        BulletDeactivate(bullet);
-        collision_count++;
-    }
-    return collision_count;
+void UnloadTextureCounted(Texture2D texture)
+{
+    live_resources.textures -= IsTextureValid(texture);
+    UnloadTexture(texture);
 }
 
-void ShipBoundPosition(Ship *ship)
+RenderTexture2D LoadRenderTextureCounted(int width, int height)
 {
-    float left_bound = ship->left_side ? 0 : SCREEN_WIDTH / 2.0f;
-    float right_bound =
-        (ship->left_side ? SCREEN_WIDTH / 2.0f : SCREEN_WIDTH) - SHIP_WIDTH;
-    ship->position.x = Clamp(ship->position.x, left_bound, right_bound);
-    ship->position.y = Clamp(ship->position.y, 0, SCREEN_HEIGHT - SHIP_HEIGHT);
+    RenderTexture2D target = LoadRenderTexture(width, height);
+    live_resources.textures += IsRenderTextureValid(target);
+    return target;
 }
 
-void ShipHandleMovement(Ship *ship, float deltatime)
+void UnloadRenderTextureCounted(RenderTexture2D target)
 {
-    int move_y = 0;
-    if (IsKeyDown(ship->key_map.move_up)) {
-        move_y = -1;
-    } else if (IsKeyDown(ship->key_map.move_down)) {
-        move_y = 1;
-    }
+    live_resources.textures -= IsRenderTextureValid(target);
+    UnloadRenderTexture(target);
+}
+
+void UnloadSoundCounted(Sound sound)
+{
+    live_resources.sounds -= IsSoundValid(sound);
+    UnloadSound(sound);
+}
+
+void UnloadMusicStreamCounted(Music music)
+{
+    live_resources.sounds -= IsMusicValid(music);
+    UnloadMusicStream(music);
+}
 
-    int move_x = 0;
-    if (IsKeyDown(ship->key_map.move_left)) {
-        move_x = -1;
-    } else if (IsKeyDown(ship->key_map.move_right)) {
-        move_x = 1;
+// The effect's voices are the sound itself and aliases of it
+void SoundPoolLoad(SoundPool *pool, SoundEffect effect, Sound sound,
+                   float volume)
+{
+    SoundEffectVoices *voices = &pool->effects[effect];
+    *voices = (SoundEffectVoices){0};
+    voices->voices[voices->voice_count++] = sound;
+    while (IsSoundValid(sound) &&
+           voices->voice_count < SOUND_VOICES_PER_EFFECT) {
+        Sound alias = LoadSoundAlias(sound);
+        if (!IsSoundValid(alias)) {
+            break;
+        }
+        live_resources.sounds++;
+        voices->voices[voices->voice_count++] = alias;
+    }
+    for (int i = 0; i < voices->voice_count; i++) {
+        SetSoundVolume(voices->voices[i], volume);
     }
+}
 
-    Vector2 normalized = Vector2Normalize((Vector2){move_x, move_y});
-    Vector2 velocity = Vector2Scale(normalized, SHIP_VELOCITY * deltatime);
-    ship->position = Vector2Add(ship->position, velocity);
+void SoundPoolUnload(SoundPool *pool)
+{
+    for (int effect = 0; effect < SOUND_EFFECT_COUNT; effect++) {
+        SoundEffectVoices *voices = &pool->effects[effect];
+        // Aliases go before the sound owning their samples
+        for (int i = voices->voice_count - 1; i > 0; i--) {
+            live_resources.sounds -= IsSoundValid(voices->voices[i]);
+            UnloadSoundAlias(voices->voices[i]);
+        }
+        if (voices->voice_count > 0) {
+            UnloadSoundCounted(voices->voices[0]);
+        }
+        voices->voice_count = 0;
+    }
+}
 
-    if (move_x || move_y) {
-        ship->last_direction = normalized;
+int SoundPoolCountActiveVoices(const SoundPool *pool)
+{
+    int count = 0;
+    for (int effect = 0; effect < SOUND_EFFECT_COUNT; effect++) {
+        const SoundEffectVoices *voices = &pool->effects[effect];
+        for (int i = 0; i < voices->voice_count; i++) {
+            count += IsSoundPlaying(voices->voices[i]);
+        }
     }
+    return count;
+}
 
-    ShipBoundPosition(ship);
+// Plays done in the same tick are started once, as they would be heard as
+// one anyway
+void SoundPoolBeginTick(SoundPool *pool)
+{
+    pool->tick++;
+}
 
-    if (ship->dash_cooldown > 0) {
-        ship->dash_cooldown -= deltatime;
-    } else if (IsKeyPressed(ship->key_map.dash)) {
-        ship->state = DASHING;
-        ship->dash_time = SHIP_DASH_DURATION;
+// Starts a free voice of the effect, or takes over the one it started longest
+// ago when none is free or SOUND_MAX_ACTIVE_VOICES are already playing
+void SoundPoolPlay(SoundPool *pool, SoundEffect effect)
+{
+    SoundEffectVoices *voices = &pool->effects[effect];
+    if (0 == voices->voice_count) {
+        return;
+    }
+    if (voices->played && voices->played_tick == pool->tick) {
+        pool->stats.merged++;
+        return;
     }
+    voices->played = true;
+    voices->played_tick = pool->tick;
+
+    // Voices start in turn, so the first playing one from next is the oldest
+    int free_voice = -1;
+    int oldest_voice = -1;
+    for (int i = 0; i < voices->voice_count; i++) {
+        int index = (voices->next + i) % voices->voice_count;
+        if (!IsSoundPlaying(voices->voices[index])) {
+            if (-1 == free_voice) {
+                free_voice = index;
+            }
+        } else if (-1 == oldest_voice) {
+            oldest_voice = index;
+        }
+    }
+    int voice = free_voice;
+    if (-1 == voice ||
+        SoundPoolCountActiveVoices(pool) >= SOUND_MAX_ACTIVE_VOICES) {
+        if (-1 == oldest_voice) {
+            pool->stats.dropped++;
+            return;
+        }
+        voice = oldest_voice;
+        StopSound(voices->voices[voice]);
+        pool->stats.stolen++;
+    }
+    PlaySound(voices->voices[voice]);
+    voices->next = (voice + 1) % voices->voice_count;
 }
 
-void ShipHandleDash(Ship *ship, float deltatime)
+// Once a frame, for the frame time HUD
+void SoundPoolUpdate(SoundPool *pool)
 {
-    float elapsed = deltatime;
-    if (deltatime > ship->dash_time) {
-        elapsed = ship->dash_time;
-        ship->state = DEFAULT;
-        ship->dash_cooldown = SHIP_DASH_COOLDOWN;
-    } else {
-        ship->dash_time -= deltatime;
+    pool->stats.active_voices = SoundPoolCountActiveVoices(pool);
+    if (pool->stats.active_voices > pool->stats.peak_voices) {
+        pool->stats.peak_voices = pool->stats.active_voices;
     }
+}
 
-    Vector2 velocity =
-        Vector2Scale(ship->last_direction, elapsed * SHIP_DASH_SPEED);
-    ship->position = Vector2Add(ship->position, velocity);
+Image AssetSourceLoadImage(const AssetSource *assets, const char *path)
+{
+    int size;
+    const unsigned char *data = AssetSourceFind(assets, path, &size);
+    return NULL != data
+               ? LoadImageFromMemory(GetFileExtension(path), data, size)
+               : LoadImage(path);
 }
 
-void ShipUpdate(Ship *ship, float deltatime)
+Sound AssetSourceLoadSound(const AssetSource *assets, const char *path)
 {
-    switch (ship->state) {
-    case DEFAULT:
-        ShipHandleMovement(ship, deltatime);
-        break;
-    case DASHING:
-        ShipHandleDash(ship, deltatime);
-        break;
+    int size;
+    const unsigned char *data = AssetSourceFind(assets, path, &size);
+    Sound sound;
+    if (NULL == data) {
+        sound = LoadSound(path);
+    } else {
+        Wave wave = LoadWaveFromMemory(GetFileExtension(path), data, size);
+        sound = LoadSoundFromWave(wave);
+        UnloadWave(wave);
     }
+    live_resources.sounds += IsSoundValid(sound);
+    return sound;
+}
+
+// The music streams from the archive's bytes, which must outlive it
+Music AssetSourceLoadMusic(const AssetSource *assets, const char *path)
+{
+    int size;
+    const unsigned char *data = AssetSourceFind(assets, path, &size);
+    Music music =
+        NULL != data
+            ? LoadMusicStreamFromMemory(GetFileExtension(path), data, size)
+            : LoadMusicStream(path);
+    live_resources.sounds += IsMusicValid(music);
+    return music;
+}
+
+Image LoadImageRotate(const AssetSource *assets, const char *path,
+                      int rotation_degree)
+{
+    Image image = AssetSourceLoadImage(assets, path);
+    ImageRotate(&image, rotation_degree);
+    return image;
 }
 
-bool ShipHandleShoot(Ship *ship, BulletPool bullet_pool)
+// Packs images into rows of one texture, tallest first, and writes the area
+// each one ended up in to sprites
+bool SpriteAtlasPack(SpriteAtlas *atlas, const Image *images, int count,
+                     Rectangle *sprites)
 {
-    bool shooting = IsKeyPressed(ship->key_map.shoot) &&
-                    ship->bullet_count < MAX_PLAYER_BULLETS;
-    if (shooting) {
-        BulletPoolAddBullet(bullet_pool, ship);
-        ship->bullet_count++;
+    assert(count <= SPRITE_ATLAS_MAX_SPRITES);
+    int order[SPRITE_ATLAS_MAX_SPRITES];
+    for (int i = 0; i < count; i++) {
+        int j = i;
+        for (; j > 0 && images[order[j - 1]].height < images[i].height; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+
+    int x = SPRITE_ATLAS_PADDING;
+    int y = SPRITE_ATLAS_PADDING;
+    int row_height = 0;
+    for (int i = 0; i < count; i++) {
+        const Image *image = &images[order[i]];
+        if (0 == image->width ||
+            image->width + 2 * SPRITE_ATLAS_PADDING > SPRITE_ATLAS_WIDTH) {
+            return false;
+        }
+        if (x + image->width + SPRITE_ATLAS_PADDING > SPRITE_ATLAS_WIDTH) {
+            x = SPRITE_ATLAS_PADDING;
+            y += row_height + SPRITE_ATLAS_PADDING;
+            row_height = 0;
+        }
+        sprites[order[i]] = (Rectangle){x, y, image->width, image->height};
+        x += image->width + SPRITE_ATLAS_PADDING;
+        row_height = image->height > row_height ? image->height : row_height;
+    }
+
+    Image atlas_image = GenImageColor(
+        SPRITE_ATLAS_WIDTH, y + row_height + SPRITE_ATLAS_PADDING, BLANK);
+    for (int i = 0; i < count; i++) {
+        ImageDraw(&atlas_image, images[i],
+                  (Rectangle){0, 0, images[i].width, images[i].height},
+                  sprites[i], WHITE);
     }
-    return shooting;
+    atlas->texture = LoadTextureCounted(atlas_image);
+    UnloadImage(atlas_image);
+    return 0 != atlas->texture.id;
 }
 
-void ShipDrawGlow(const Ship *ship)
+void SpriteAtlasUnload(SpriteAtlas *atlas)
 {
-    Vector2 center = RectangleGetCenter(
-        (Rectangle){ship->position.x, ship->position.y, ship->texture.width,
-                    ship->texture.height});
-    Rectangle rectangle =
-        CreateRectangleFromCenter(center.x, center.y, ship->glow_texture.width,
-                                  ship->glow_texture.height);
-    DrawTexture(ship->glow_texture, roundf(rectangle.x), roundf(rectangle.y),
-                WHITE);
+    SetShapesTexture((Texture2D){0}, (Rectangle){0});
+    MemFree(atlas->font.recs);
+    UnloadTextureCounted(atlas->texture);
+    *atlas = (SpriteAtlas){0};
+    // The layouts refer to the font's glyphs
+    TextCacheClear(&text_cache);
 }
 
-void ShipDraw(const Ship *ship)
+// Draw calls queued in batch since it was last drawn, one per run of
+// vertices sharing a texture and a primitive type
+int RenderBatchCountDrawCalls(const rlRenderBatch *batch)
 {
-    DrawTextureV(ship->texture, ship->position, WHITE);
-    if (ship->dash_cooldown <= 0) {
-        ShipDrawGlow(ship);
+    int count = 0;
+    for (int i = 0; i < batch->drawCounter; i++) {
+        count += batch->draws[i].vertexCount > 0;
     }
+    return count;
+}
 
-#ifdef DRAW_HITBOX
-    DrawRectangleLinesEx(ShipGetHitbox(ship), 1.0f, RED);
-#endif // NHITBOX
+// Draws what is queued, counted in frame_draw_calls
+void FlushDrawCalls(void)
+{
+    frame_draw_calls += RenderBatchCountDrawCalls(&render_batch);
+    rlDrawRenderBatchActive();
 }
 
-void ShipDrawHealth(const Ship *ship)
+// Changing the blend mode flushes the batch, so these count what it held
+void BeginBlendModeCounted(int mode)
 {
-    char health_str[10];
-    sprintf(health_str, "%d", ship->health);
-    int health_width = MeasureText(health_str, 24);
-    int health_x = ship->left_side
-                       ? SHIP_HEALTH_X_OFF
-                       : SCREEN_WIDTH - health_width - SHIP_HEALTH_X_OFF;
-    DrawText(health_str, health_x, SHIP_HEALTH_Y_OFF, 24, RAYWHITE);
+    FlushDrawCalls();
+    BeginBlendMode(mode);
 }
 
-Texture2D LoadTextureRotate(const char *filename, int rotation_degree)
+void EndBlendModeCounted(void)
 {
-    Image image = LoadImage(filename);
-    ImageRotate(&image, rotation_degree);
-    Texture2D texture = LoadTextureFromImage(image);
-    UnloadImage(image);
-    return texture;
+    FlushDrawCalls();
+    EndBlendMode();
 }
 
-void DrawWinDialog(Winner winner)
+void DrawWinDialog(Winner winner, SimMode mode)
 {
     assert(winner != NONE);
 
-    const char *win_str;
+    char win_str[32];
     Color text_color;
-    if (LEFT == winner) {
-        win_str = "Red Wins!";
+    if (DRAW == winner) {
+        strcpy(win_str, "Draw.");
+        text_color = WHITE;
+    } else if (SIM_MODE_FREE_FOR_ALL == mode) {
+        sprintf(win_str, "P%d Wins!", winner + 1);
+        text_color = (winner % 2) ? BLUE : RED;
+    } else if (LEFT == winner) {
+        strcpy(win_str, "Red Wins!");
         text_color = RED;
-    } else if (RIGHT == winner) {
-        win_str = "Blue Wins!";
-        text_color = BLUE;
     } else {
-        win_str = "Draw.";
-        text_color = WHITE;
+        strcpy(win_str, "Blue Wins!");
+        text_color = BLUE;
     }
     const float y_offset = -50.0f;
     DrawTextCenter(
@@ -549,63 +1122,248 @@ void DrawWinButtons(const Gui *gui)
                    DEFAULT_LETTER_SPACING, BLACK);
 }
 
+bool NetPlayOpenUdp(NetPlay *net, int local_port, const char *peer_host,
+                    int peer_port, int tick_rate)
+{
+    *net = (NetPlay){0};
+    if (!UdpTransportOpen(&net->udp, local_port, peer_host, peer_port)) {
+        return false;
+    }
+    // The host plays the left ship
+    int local_player = (NULL == peer_host) ? 0 : 1;
+    if (!RollbackSessionInit(&net->session, &net->udp.transport, local_player,
+                             tick_rate, (uint32_t)time(NULL),
+                             SIM_DEFAULT_BULLET_CAPACITY)) {
+        UdpTransportClose(&net->udp);
+        return false;
+    }
+    return true;
+}
+
+bool NetPlayOpenLoopback(NetPlay *net, float latency, float jitter,
+                         float loss, int tick_rate)
+{
+    *net = (NetPlay){.loopback = true};
+    LoopbackNetworkInit(&net->network, latency, jitter, loss,
+                        (uint32_t)time(NULL));
+    return RollbackSessionInit(&net->session,
+                               &net->network.ends[0].transport, 0, tick_rate,
+                               (uint32_t)time(NULL),
+                               SIM_DEFAULT_BULLET_CAPACITY) &&
+           RollbackSessionInit(&net->peer_session,
+                               &net->network.ends[1].transport, 1, tick_rate,
+                               0, SIM_DEFAULT_BULLET_CAPACITY) &&
+           SimInit(&net->peer_sim, SIM_DEFAULT_BULLET_CAPACITY);
+}
+
+void NetPlayClose(NetPlay *net)
+{
+    RollbackSessionDeinit(&net->session);
+    if (net->loopback) {
+        RollbackSessionDeinit(&net->peer_session);
+        SimDeinit(&net->peer_sim);
+    } else {
+        UdpTransportClose(&net->udp);
+    }
+}
+
+void NetPlayRestart(NetPlay *net)
+{
+    RollbackSessionRestart(&net->session, (uint32_t)time(NULL));
+    if (net->loopback) {
+        RollbackSessionRestart(&net->peer_session, 0);
+    }
+}
+
+// Polls session and, when the peers have just agreed on a match, resets sim
+// with the seed they agreed on
+bool NetPlaySyncSession(RollbackSession *session, SimState *sim)
+{
+    bool running = ROLLBACK_RUNNING == session->status;
+    if (!RollbackSessionPoll(session, sim)) {
+        return false;
+    }
+    if (!running) {
+        SimReset(sim, SIM_DUEL_SETUP, session->seed);
+    }
+    return true;
+}
+
+InputMask InputSourceSamplePlayer(InputSource *const sources[SIM_MAX_SHIPS],
+                                  const SimState *sim, int player)
+{
+    return sources[player]->Sample(sources[player], sim, player);
+}
+
+// Runs the in-process peer, if any, and returns whether the local session is
+// ready for its next tick
+bool NetPlayPrepareTick(NetPlay *net,
+                        InputSource *const sources[SIM_MAX_SHIPS],
+                        SimState *sim, float deltatime)
+{
+    if (net->loopback) {
+        LoopbackNetworkAdvance(&net->network, deltatime);
+        RollbackSession *peer = &net->peer_session;
+        if (NetPlaySyncSession(peer, &net->peer_sim)) {
+            InputMask input = InputSourceSamplePlayer(
+                sources, &net->peer_sim, peer->local_player);
+            SimEvents peer_events;
+            RollbackSessionStep(peer, &net->peer_sim, input, deltatime,
+                                &peer_events);
+        }
+    }
+    return NetPlaySyncSession(&net->session, sim);
+}
+
+bool NetPlayStep(NetPlay *net, InputSource *const sources[SIM_MAX_SHIPS],
+                 SimState *sim, float deltatime, SimEvents *events)
+{
+    RollbackSession *session = &net->session;
+    InputMask input =
+        InputSourceSamplePlayer(sources, sim, session->local_player);
+    SimEvents tick_events;
+    bool stepped =
+        RollbackSessionStep(session, sim, input, deltatime, &tick_events);
+    *events |= tick_events;
+    return stepped;
+}
+
+// Resets the match only, everything in game->resources stays as loaded
 void GameReset(Game *game)
 {
-    game->ship1 = (Ship){
-        .position = {SCREEN_HALF.x * 0.5f - SHIP_WIDTH / 2.0f,
-                     SCREEN_HALF.y * 0.5f - SHIP_HEIGHT / 2.0f},
-        .key_map = {KEY_W, KEY_S, KEY_A, KEY_D, KEY_X, KEY_C},
-        .left_side = true,
-        .bullet_count = 0,
-        .texture = LoadTextureRotate(LEFT_SHIP_TEXTURE_FILEPATH, 90),
-        .health = SHIP_INITIAL_HEALTH,
-        .glow_texture = LoadTextureRotate(LEFT_SHIP_GLOW_TEXTURE_FILEPATH, 90),
-        .state = DEFAULT,
-        .last_direction = {0.0f, 1.0f}};
-
-    game->ship2 =
-        (Ship){.position = {SCREEN_HALF.x * 1.5f - SHIP_WIDTH / 2.0f,
-                            SCREEN_HALF.y * 1.5f - SHIP_HEIGHT / 2.0f},
-               .key_map = {KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT, KEY_COMMA,
-                           KEY_PERIOD},
-               .left_side = false,
-               .bullet_count = 0,
-               .texture = LoadTextureRotate(RIGHT_SHIP_TEXTURE_FILEPATH, -90),
-               .health = SHIP_INITIAL_HEALTH,
-               .glow_texture =
-                   LoadTextureRotate(RIGHT_SHIP_GLOW_TEXTURE_FILEPATH, -90),
-               .state = DEFAULT,
-               .last_direction = {0.0f, -1.0f}};
-
-    size_t bullet_pool_bytes = MAX_POOL_BULLETS * sizeof(game->bullet_pool[0]);
-    memset(game->bullet_pool, 0, bullet_pool_bytes);
-
-    SeekMusicStream(game->background_music, 0.0f);
-    game->winner = NONE;
+    assert(game->resources.loaded);
+    ReplayWriterClose(&game->replay_writer);
+    if (GameIsReplaying(game)) {
+        SimReset(&game->sim, ReplayHeaderGetSetup(&game->replay.header),
+                 game->replay.header.seed);
+        game->replay_source = ReplayInputSourceCreate(&game->replay);
+    } else {
+        SimReset(&game->sim, game->setup, (uint32_t)time(NULL));
+    }
+    if (NULL != game->net) {
+        NetPlayRestart(game->net);
+    }
+
+    game->tick_accumulator = 0.0f;
+    game->has_quick_save = false;
+    for (int i = 0; i < KEYBOARD_COUNT; i++) {
+        game->keyboards[i].latched = 0;
+        game->keyboards[i].sampled = 0;
+    }
+
+    AudioThreadLock(game->resources.music_thread);
+    SeekMusicStream(game->resources.background_music, 0.0f);
+    AudioThreadUnlock(game->resources.music_thread);
 }
 
-void GameLoadSounds(Game *game)
+// Builds the sprite atlas, needs the window to be open
+bool GameLoadSprites(Game *game)
 {
-    game->shoot_sfx = LoadSound(SHOOT_SFX_FILEPATH);
-    game->hit_sfx = LoadSound(HIT_SFX_FILEPATH);
-    game->win_sfx = LoadSound(WIN_SFX_FILEPATH);
-    game->pause_sfx = LoadSound(PAUSE_SFX_FILEPATH);
-    game->click_sfx = LoadSound(CLICK_SFX_FILEPATH);
-    game->background_music = LoadMusicStream(BACKGROUND_MUSIC_FILEPATH);
+    GameResources *resources = &game->resources;
+    Image images[SPRITE_ATLAS_MAX_SPRITES];
+    Rectangle *sprites[SPRITE_ATLAS_MAX_SPRITES];
+    int count = 0;
+    const AssetSource *assets = &resources->assets;
+
+    const char *ship_paths[SHIP_COLOR_COUNT] = {LEFT_SHIP_TEXTURE_FILEPATH,
+                                                RIGHT_SHIP_TEXTURE_FILEPATH};
+    const char *glow_paths[SHIP_COLOR_COUNT] = {
+        LEFT_SHIP_GLOW_TEXTURE_FILEPATH, RIGHT_SHIP_GLOW_TEXTURE_FILEPATH};
+    for (int color = 0; color < SHIP_COLOR_COUNT; color++) {
+        for (int facing_right = 0; facing_right < 2; facing_right++) {
+            int rotation = facing_right ? 90 : -90;
+            images[count] =
+                LoadImageRotate(assets, ship_paths[color], rotation);
+            sprites[count++] = &resources->ship_sprites[color][facing_right];
+            images[count] =
+                LoadImageRotate(assets, glow_paths[color], rotation);
+            sprites[count++] =
+                &resources->ship_glow_sprites[color][facing_right];
+        }
+    }
+    images[count] = AssetSourceLoadImage(assets, PAUSE_ICON_FILEPATH);
+    sprites[count++] = &resources->pause_icon_sprite;
+    // Sampled in the middle, away from the padding
+    Rectangle white;
+    images[count] = GenImageColor(3, 3, WHITE);
+    sprites[count++] = &white;
+    Font font = GetFontDefault();
+    Rectangle font_sprite;
+    images[count] = LoadImageFromTexture(font.texture);
+    sprites[count++] = &font_sprite;
+
+    Rectangle packed[SPRITE_ATLAS_MAX_SPRITES];
+    bool built = SpriteAtlasPack(&sprite_atlas, images, count, packed);
+    for (int i = 0; i < count; i++) {
+        *sprites[i] = packed[i];
+        UnloadImage(images[i]);
+    }
+    if (!built) {
+        return false;
+    }
 
-    SetSoundVolume(game->shoot_sfx, 0.5f);
-    SetSoundVolume(game->hit_sfx, 0.5f);
-    SetSoundVolume(game->win_sfx, 0.3f);
-    SetSoundVolume(game->pause_sfx, 0.3f);
-    SetSoundVolume(game->click_sfx, 0.4f);
-    SetMusicVolume(game->background_music, 0.3f);
+    sprite_atlas.white = (Rectangle){white.x + 1, white.y + 1, 1, 1};
+    SetShapesTexture(sprite_atlas.texture, sprite_atlas.white);
+    sprite_atlas.font = font;
+    sprite_atlas.font.texture = sprite_atlas.texture;
+    sprite_atlas.font.recs = MemAlloc(font.glyphCount * sizeof(Rectangle));
+    for (int i = 0; i < font.glyphCount; i++) {
+        sprite_atlas.font.recs[i] = font.recs[i];
+        sprite_atlas.font.recs[i].x += font_sprite.x;
+        sprite_atlas.font.recs[i].y += font_sprite.y;
+    }
+    return true;
+}
 
-    game->background_music.looping = true;
+void MusicThreadUpdate(void *music)
+{
+    UpdateMusicStream(*(Music *)music);
+}
+
+void GameLoadSounds(Game *game)
+{
+    GameResources *resources = &game->resources;
+    const AssetSource *assets = &resources->assets;
+    SoundPool *sounds = &resources->sounds;
+    SoundPoolLoad(sounds, SOUND_EFFECT_SHOOT,
+                  AssetSourceLoadSound(assets, SHOOT_SFX_FILEPATH), 0.5f);
+    SoundPoolLoad(sounds, SOUND_EFFECT_HIT,
+                  AssetSourceLoadSound(assets, HIT_SFX_FILEPATH), 0.5f);
+    SoundPoolLoad(sounds, SOUND_EFFECT_WIN,
+                  AssetSourceLoadSound(assets, WIN_SFX_FILEPATH), 0.3f);
+    SoundPoolLoad(sounds, SOUND_EFFECT_PAUSE,
+                  AssetSourceLoadSound(assets, PAUSE_SFX_FILEPATH), 0.3f);
+    SoundPoolLoad(sounds, SOUND_EFFECT_CLICK,
+                  AssetSourceLoadSound(assets, CLICK_SFX_FILEPATH), 0.4f);
+    // The stream is played from two halves, refilled in turn, which together
+    // make the decode-ahead buffer
+    SetAudioStreamBufferSizeDefault(game->music_buffer_time / 2.0f *
+                                    MUSIC_SAMPLE_RATE);
+    resources->background_music =
+        AssetSourceLoadMusic(assets, BACKGROUND_MUSIC_FILEPATH);
+    SetAudioStreamBufferSizeDefault(0);
+
+    SetMusicVolume(resources->background_music, 0.3f);
+
+    resources->background_music.looping = true;
+
+    // Checking a few times per half refills it long before the other half
+    // runs out, whatever the main loop is doing
+    if (IsMusicValid(resources->background_music)) {
+        resources->music_thread =
+            AudioThreadStart(&MusicThreadUpdate, &resources->background_music,
+                             game->music_buffer_time / 8.0f);
+        if (NULL == resources->music_thread) {
+            TraceLog(LOG_WARNING, "Could not start the music thread, the "
+                                  "music is decoded between frames");
+            resources->music_thread_failed = true;
+        }
+    }
 }
 
 void GameInitGui(Game *game)
 {
-    Texture2D pause_icon = LoadTexture(PAUSE_ICON_FILEPATH);
+    Rectangle pause_icon = game->resources.pause_icon_sprite;
     game->gui = (Gui){
         .main_menu_gui =
             {.play_button = CreateRectangleFromCenter(
@@ -642,22 +1400,65 @@ void GameInitGui(Game *game)
                         SCREEN_HALF.x, SCREEN_HALF.y + 70.0f, 100.0f, 30.0f)}};
 }
 
-void GameInit(Game *game)
+void GameInitInput(Game *game)
 {
+    game->keyboards[0] = KeyboardInputSourceCreate(
+        (ShipKeyMap){KEY_W, KEY_S, KEY_A, KEY_D, KEY_X, KEY_C});
+    game->keyboards[1] = KeyboardInputSourceCreate((ShipKeyMap){
+        KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT, KEY_COMMA, KEY_PERIOD});
+    for (int i = 0; i < SIM_MAX_SHIPS; i++) {
+        game->bots[i] =
+            BotInputSourceCreate(game->bot_difficulty, game->tick_rate);
+        bool keyboard =
+            i < KEYBOARD_COUNT && !(1 == i && game->has_bot) && !soak.active;
+        if (GameIsReplaying(game)) {
+            game->input_sources[i] = &game->replay_source.source;
+        } else if (keyboard) {
+            game->input_sources[i] = &game->keyboards[i].source;
+        } else {
+            game->input_sources[i] = &game->bots[i].source;
+        }
+    }
+}
+
+// Loads every asset the first time it is called and does nothing after
+bool GameLoadResources(Game *game)
+{
+    if (game->resources.loaded) {
+        return true;
+    }
+    if (!GameLoadSprites(game)) {
+        return false;
+    }
     GameLoadSounds(game);
+    game->resources.loaded = true;
+    return true;
+}
+
+bool GameInit(Game *game)
+{
+    if (!GameLoadResources(game)) {
+        return false;
+    }
+    GameInitInput(game);
     GameReset(game);
     GameInitGui(game);
+    return true;
 }
 
 void GameDeinit(Game *game)
 {
-    UnloadTexture(game->ship1.texture);
-    UnloadTexture(game->ship2.texture);
-    UnloadTexture(game->gui.playing_gui.pause_button.content.texture.texture);
-    UnloadSound(game->shoot_sfx);
-    UnloadSound(game->hit_sfx);
-    UnloadSound(game->win_sfx);
-    UnloadMusicStream(game->background_music);
+    GameResources *resources = &game->resources;
+    SpriteAtlasUnload(&sprite_atlas);
+    SoundPoolUnload(&resources->sounds);
+    AudioThreadStop(resources->music_thread);
+    resources->music_thread = NULL;
+    UnloadMusicStreamCounted(resources->background_music);
+    AssetSourceClose(&resources->assets);
+    ReplayWriterClose(&game->replay_writer);
+    ReplayClose(&game->replay);
+    SimDeinit(&game->quick_save);
+    SimDeinit(&game->sim);
 }
 
 GameState *MainMenuStateUpdate(Game *game, float deltatime)
@@ -685,31 +1486,220 @@ void MainMenuStateDraw(const Game *game)
     DrawButton(&game->gui.main_menu_gui.exit_button);
 }
 
-void PlayingStateInit(Game *game) { PlayMusicStream(game->background_music); }
+// Starts recording the match into the replays directory, named after the
+// time it started with a counter after it when another match started within
+// the same second
+void GameStartRecording(Game *game)
+{
+    char name[32];
+    time_t now = time(NULL);
+    strftime(name, sizeof(name), "%Y%m%d-%H%M%S", localtime(&now));
+    MakeDirectory(REPLAYS_DIRECTORY);
+    ReplayHeader header = ReplayHeaderCreate(&game->sim, game->tick_rate);
+    char path[64];
+    for (int i = 1; i <= REPLAY_MAX_NAME_TRIES; i++) {
+        if (1 == i) {
+            snprintf(path, sizeof(path), REPLAYS_DIRECTORY "/%s.swr", name);
+        } else {
+            snprintf(path, sizeof(path), REPLAYS_DIRECTORY "/%s-%d.swr",
+                     name, i);
+        }
+        if (ReplayWriterOpen(&game->replay_writer, path, header)) {
+            return;
+        }
+        if (!FileExists(path)) {
+            break;
+        }
+    }
+    TraceLog(LOG_WARNING, "Could not record replay to %s", path);
+}
+
+void PlayingStateInit(Game *game)
+{
+    AudioThreadLock(game->resources.music_thread);
+    PlayMusicStream(game->resources.background_music);
+    AudioThreadUnlock(game->resources.music_thread);
+}
+
+// Runs one tick, returns false if it could not run yet because the network
+// peer is behind
+bool GameStep(Game *game, float tick_duration, SimEvents *events)
+{
+    if (NULL != game->net && !NetPlayPrepareTick(game->net, game->input_sources,
+                                                 &game->sim, tick_duration)) {
+        return false;
+    }
+    bool match_start = 0 == game->sim.tick;
+    if (match_start && !GameIsReplaying(game) &&
+        !ReplayWriterIsOpen(&game->replay_writer)) {
+        GameStartRecording(game);
+    }
+
+    if (NULL != game->net) {
+        // The session records confirmed ticks itself
+        return NetPlayStep(game->net, game->input_sources, &game->sim,
+                           tick_duration, events);
+    }
+
+    InputMask inputs[SIM_MAX_SHIPS];
+    InputSourcesSample(game->input_sources, &game->sim, inputs);
+    ReplayWriterAppend(&game->replay_writer, inputs);
+    *events |= SimStep(&game->sim, inputs, tick_duration);
+    return true;
+}
+
+// Quick saves are not available over the network, where both peers would have
+// to agree on loading one
+void GameQuickSave(Game *game)
+{
+    if (NULL != game->net) {
+        return;
+    }
+    SimSaveSnapshot(&game->sim, &game->quick_save);
+    game->has_quick_save = true;
+}
+
+void GameQuickLoad(Game *game)
+{
+    if (NULL != game->net || !game->has_quick_save) {
+        return;
+    }
+    // The recorded inputs no longer lead to the loaded state, end the replay
+    // at the current tick so it stays playable
+    ReplayWriterClose(&game->replay_writer);
+    SimLoadSnapshot(&game->sim, &game->quick_save);
+    game->tick_accumulator = 0.0f;
+}
+
+// Whether the current tick can no longer be rolled back
+bool GameTickConfirmed(const Game *game)
+{
+    return NULL == game->net ||
+           RollbackSessionConfirmed(&game->net->session, game->sim.tick);
+}
+
+// NULL while the network play goes as it should
+const char *NetPlayGetStatus(const NetPlay *net)
+{
+    if (ROLLBACK_SYNCING == net->session.status) {
+        return "WAITING FOR PLAYER";
+    }
+    if (ROLLBACK_INCOMPATIBLE == net->session.status) {
+        return "OTHER PLAYER RUNS A DIFFERENT VERSION";
+    }
+    return NULL;
+}
+
+void DrawNetPlayStatus(const char *status)
+{
+    DrawTextCenter(status, (Vector2){SCREEN_HALF.x, SCREEN_HALF.y + 60.0f},
+                   16.0f, DEFAULT_LETTER_SPACING, WHITE);
+}
+
+// A duel keeps its health counters in the top corners
+bool GameIsDuel(const Game *game)
+{
+    const SimSetup *setup = &game->sim.setup;
+    return 2 == setup->ship_count && SIM_MODE_TEAMS == setup->mode;
+}
+
+bool UiLayerLoad(UiLayer *layer)
+{
+    *layer = (UiLayer){0};
+    layer->texture = LoadRenderTextureCounted(SCREEN_WIDTH, SCREEN_HEIGHT);
+    return 0 != layer->texture.id;
+}
+
+void UiLayerUnload(UiLayer *layer)
+{
+    UnloadRenderTextureCounted(layer->texture);
+    *layer = (UiLayer){0};
+}
+
+// Redraws the layer if the game shows something else in it than last time.
+// Must not be called while drawing to another render texture.
+void UiLayerUpdate(UiLayer *layer, const Game *game)
+{
+    UiLayerContent content = {.has_health = GameIsDuel(game)};
+    if (content.has_health) {
+        content.health[0] = game->sim.ships[0].health;
+        content.health[1] = game->sim.ships[1].health;
+    }
+    if (NULL != game->net) {
+        content.net_status = NetPlayGetStatus(game->net);
+    }
+    const UiLayerContent *drawn = &layer->content;
+    if (layer->drawn && content.has_health == drawn->has_health &&
+        content.health[0] == drawn->health[0] &&
+        content.health[1] == drawn->health[1] &&
+        content.net_status == drawn->net_status) {
+        return;
+    }
+    layer->content = content;
+    layer->drawn = true;
+
+    BeginTextureMode(layer->texture);
+    ClearBackground(BLANK);
+    // Blend the colors as usual but add up coverage, so the texture holds
+    // premultiplied colors and composites like drawing straight to the screen
+    rlSetBlendFactorsSeparate(0x0302, 0x0303, 1, 0x0303, 0x8006, 0x8006);
+    BeginBlendModeCounted(BLEND_CUSTOM_SEPARATE);
+    DrawAtlasText("Hello Bup :3", 100, 100, 24, (Color){255, 255, 255, 4});
+    if (content.has_health) {
+        ShipDrawHealth(&game->sim.ships[0]);
+        ShipDrawHealth(&game->sim.ships[1]);
+    }
+    DrawButton(&game->gui.playing_gui.pause_button);
+    if (NULL != content.net_status) {
+        DrawNetPlayStatus(content.net_status);
+    }
+    // Already flushed and counted by the blend mode change
+    EndBlendModeCounted();
+    EndTextureMode();
+}
+
+// Switching to the premultiplied blend and back flushes the batch either
+// side, so a duel frame takes two draw calls: the atlas sprites, then this
+void UiLayerDraw(const UiLayer *layer)
+{
+    Rectangle source = {0, 0, (float)layer->texture.texture.width,
+                        (float)-layer->texture.texture.height};
+    BeginBlendModeCounted(BLEND_ALPHA_PREMULTIPLY);
+    DrawTextureRec(layer->texture.texture, source, (Vector2){0, 0}, WHITE);
+    EndBlendModeCounted();
+}
 
 void PlayingStateDraw(const Game *game)
 {
+    PROFILE_BEGIN(PlayingStateDraw);
     ClearBackground(BLACK);
-    DrawText("Hello Bup :3", 100, 100, 24, (Color){255, 255, 255, 4});
-    BulletPoolDraw(game->bullet_pool);
-    ShipDraw(&game->ship1);
-    ShipDraw(&game->ship2);
-    ShipDrawHealth(&game->ship1);
-    ShipDrawHealth(&game->ship2);
-    DrawButton(&game->gui.playing_gui.pause_button);
+    float alpha = GameGetTickAlpha(game);
+    BulletPoolDraw(&game->sim.bullets, alpha);
+    const SimSetup *setup = &game->sim.setup;
+    const GameResources *resources = &game->resources;
+    for (int i = 0; i < setup->ship_count; i++) {
+        const Ship *ship = &game->sim.ships[i];
+        if (ShipIsAlive(ship)) {
+            int color = ship->team % SHIP_COLOR_COUNT;
+            ShipDraw(ship, alpha,
+                     resources->ship_sprites[color][ship->facing_right],
+                     resources->ship_glow_sprites[color][ship->facing_right]);
+        }
+    }
+    // Labels follow their ships, so only the duel's corner counters belong
+    // to the UI layer
+    for (int i = 0; i < setup->ship_count && !GameIsDuel(game); i++) {
+        const Ship *ship = &game->sim.ships[i];
+        if (ShipIsAlive(ship)) {
+            ShipDrawLabel(ship, i, setup->mode, alpha);
+        }
+    }
+    UiLayerDraw(&ui_layer);
+    PROFILE_END(PlayingStateDraw);
 }
 
 GameState *PlayingStateUpdate(Game *game, float deltatime)
 {
-    // Unpacking Game struct
-    Ship *ship1 = &game->ship1;
-    Ship *ship2 = &game->ship2;
-    BulletPool *bullet_pool = &game->bullet_pool;
-    Winner *winner = &game->winner;
-    Sound *shoot_sfx = &game->shoot_sfx;
-    Sound *hit_sfx = &game->hit_sfx;
-    Music *background_music = &game->background_music;
-
     if (WindowShouldClose()) {
         return NULL;
     }
@@ -718,51 +1708,105 @@ GameState *PlayingStateUpdate(Game *game, float deltatime)
         return &pause_state;
     }
 
-    BulletPoolUpdateMovement(*bullet_pool, deltatime);
-
-    ShipUpdate(ship1, deltatime);
-    if (ShipHandleShoot(ship1, *bullet_pool)) {
-        PlaySound(*shoot_sfx);
+    if (IsKeyPressed(KEY_F5)) {
+        GameQuickSave(game);
     }
-
-    ShipUpdate(ship2, deltatime);
-    if (ShipHandleShoot(ship2, *bullet_pool)) {
-        PlaySound(*shoot_sfx);
+    if (IsKeyPressed(KEY_F9)) {
+        GameQuickLoad(game);
     }
 
-    int collision_count =
-        BulletPoolHandleCollisions(*bullet_pool, ship1, ship2);
-    if (collision_count) {
-        PlaySound(*hit_sfx);
+    double input_start = GetTime();
+    for (int i = 0; i < KEYBOARD_COUNT; i++) {
+        KeyboardInputSourcePoll(&game->keyboards[i]);
     }
-    ship2->health =
-        (ship2->health < collision_count) ? 0 : ship2->health - collision_count;
-
-    collision_count = BulletPoolHandleCollisions(*bullet_pool, ship2, ship1);
-    if (collision_count) {
-        PlaySound(*hit_sfx);
-    }
-    ship1->health =
-        (ship1->health < collision_count) ? 0 : ship1->health - collision_count;
+    game->input_time = GetTime() - input_start;
+
+    // Step the simulation in fixed ticks, carrying the remainder over to the
+    // next frame
+    float tick_duration = GameGetTickDuration(game);
+    game->tick_accumulator +=
+        fminf(deltatime, MAX_FRAME_TIME) * game->playback_speed;
+    SimEvents events = 0;
+    while (game->tick_accumulator >= tick_duration) {
+        SimEvents tick_events = 0;
+        if (!GameStep(game, tick_duration, &tick_events)) {
+            // Wait for the network peer instead of catching up later
+            game->tick_accumulator = 0.0f;
+            break;
+        }
+        game->tick_accumulator -= tick_duration;
+        events |= tick_events;
 
-    if (0 == ship1->health && 0 == ship2->health) {
-        *winner = DRAW;
-    } else if (0 == ship1->health) {
-        *winner = RIGHT;
-    } else if (0 == ship2->health) {
-        *winner = LEFT;
+        SoundPoolBeginTick(&game->resources.sounds);
+        if (tick_events & SIM_EVENT_SHOOT) {
+            SoundPoolPlay(&game->resources.sounds, SOUND_EFFECT_SHOOT);
+        }
+        if (tick_events & SIM_EVENT_HIT) {
+            SoundPoolPlay(&game->resources.sounds, SOUND_EFFECT_HIT);
+        }
+        if (events & SIM_EVENT_WIN) {
+            break;
+        }
     }
 
-    if (NONE != *winner) {
+    // Over the network a win may still be undone by a late remote input
+    if ((events & SIM_EVENT_WIN) && GameTickConfirmed(game)) {
         return &win_state;
     }
+    // Replay of a match that was quit before anyone won
+    if (GameIsReplaying(game) &&
+        ReplayInputSourceFinished(&game->replay_source)) {
+        GameReset(game);
+        return &main_menu_state;
+    }
 
-    UpdateMusicStream(*background_music);
+    if (game->resources.music_thread_failed) {
+        UpdateMusicStream(game->resources.background_music);
+    }
 
     return &playing_state;
 }
 
-void PauseStateInit(Game *game) { PlaySound(game->pause_sfx); }
+void DimScreen(Color color)
+{
+    rlSetBlendFactorsSeparate(0x0302, 0x0303, 1, 0x0303, 0x8006, 0x8006);
+    BeginBlendModeCounted(BLEND_CUSTOM_SEPARATE);
+    DrawRectangle(0, 0, INITIAL_WINDOW_WIDTH, INITIAL_WINDOW_HEIGHT, color);
+    EndBlendModeCounted();
+}
+
+// Captures the current gameplay frame into frozen_frame with DrawOverlay on
+// top, so the states that pause the game only have to draw their buttons
+void FreezeFrame(Game *game, void (*DrawOverlay)(const Game *game))
+{
+    UiLayerUpdate(&ui_layer, game);
+    BeginTextureMode(frozen_frame);
+    PlayingStateDraw(game);
+    DrawOverlay(game);
+    FlushDrawCalls();
+    EndTextureMode();
+}
+
+void DrawFrozenFrame(void)
+{
+    Rectangle source = {0, 0, (float)frozen_frame.texture.width,
+                        (float)-frozen_frame.texture.height};
+    DrawTextureRec(frozen_frame.texture, source, (Vector2){0, 0}, WHITE);
+}
+
+void PauseStateDrawOverlay(const Game *game)
+{
+    (void)game;
+    DimScreen(PAUSE_DIM_COLOR);
+    DrawTextCenter("PAUSED", (Vector2){SCREEN_HALF.x, SCREEN_HALF.y - 50.0f},
+                   64.0f, DEFAULT_LETTER_SPACING, WHITE);
+}
+
+void PauseStateInit(Game *game)
+{
+    SoundPoolPlay(&game->resources.sounds, SOUND_EFFECT_PAUSE);
+    FreezeFrame(game, &PauseStateDrawOverlay);
+}
 
 GameState *PauseStateUpdate(Game *game, float deltatime)
 {
@@ -780,32 +1824,29 @@ GameState *PauseStateUpdate(Game *game, float deltatime)
     if (RectangleCheckPressed(
             GetTextButtonRectangle(&game->gui.pause_gui.main_menu_button))) {
         GameReset(game);
-        PlaySound(game->click_sfx);
+        SoundPoolPlay(&game->resources.sounds, SOUND_EFFECT_CLICK);
         return &main_menu_state;
     }
     return &pause_state;
 }
 
-void DimScreen(Color color)
-{
-    rlSetBlendFactorsSeparate(0x0302, 0x0303, 1, 0x0303, 0x8006, 0x8006);
-    BeginBlendMode(BLEND_CUSTOM_SEPARATE);
-    DrawRectangle(0, 0, INITIAL_WINDOW_WIDTH, INITIAL_WINDOW_HEIGHT, color);
-    EndBlendMode();
-}
-
 void PauseStateDraw(const Game *game)
 {
-    PlayingStateDraw(game);
-
-    DimScreen(PAUSE_DIM_COLOR);
-    DrawTextCenter("PAUSED", (Vector2){SCREEN_HALF.x, SCREEN_HALF.y - 50.0f},
-                   64.0f, DEFAULT_LETTER_SPACING, WHITE);
+    DrawFrozenFrame();
     DrawTextButton(&game->gui.pause_gui.resume_button);
     DrawTextButton(&game->gui.pause_gui.main_menu_button);
 }
 
-void WinStateInit(Game *game) { PlaySound(game->win_sfx); }
+void WinStateDrawOverlay(const Game *game)
+{
+    DrawWinDialog(game->sim.winner, game->sim.setup.mode);
+}
+
+void WinStateInit(Game *game)
+{
+    SoundPoolPlay(&game->resources.sounds, SOUND_EFFECT_WIN);
+    FreezeFrame(game, &WinStateDrawOverlay);
+}
 
 GameState *WinStateUpdate(Game *game, float deltatime)
 {
@@ -825,8 +1866,7 @@ GameState *WinStateUpdate(Game *game, float deltatime)
 
 void WinStateDraw(const Game *game)
 {
-    PlayingStateDraw(game);
-    DrawWinDialog(game->winner);
+    DrawFrozenFrame();
     DrawWinButtons(&game->gui);
 }
 
@@ -867,8 +1907,72 @@ Rectangle CreateScreenDrawDestination(void)
     return result;
 }
 
-void DrawScreenToWindow(RenderTexture2D screen)
+void FrameHudAdd(FrameHud *hud, const FrameSample *sample)
 {
+    FrameStatsAdd(&hud->stats, sample);
+    double now = GetTime();
+    if (hud->shown && now - hud->summary_time >= FRAME_HUD_REFRESH_TIME) {
+        hud->summary = FrameStatsSummarize(&hud->stats, FRAME_HUD_WINDOW);
+        hud->summary_time = now;
+    }
+}
+
+// A bar per recent frame, green within the monitor's frame budget, then the
+// percentiles, where the time went and the sound voices mixing, in window
+// pixels at the bottom left
+void FrameHudDraw(const FrameHud *hud)
+{
+    const FrameSummary *summary = &hud->summary;
+    float budget = 1.0f / fmaxf(GetMonitorRefreshRate(GetCurrentMonitor()), 1);
+    float scale = FRAME_HUD_GRAPH_HEIGHT / FRAME_HUD_GRAPH_MAX_TIME;
+    float bottom = GetScreenHeight() - 86.0f;
+    DrawRectangle(0, bottom - FRAME_HUD_GRAPH_HEIGHT, GetScreenWidth(),
+                  FRAME_HUD_GRAPH_HEIGHT + 86, (Color){0, 0, 0, 170});
+    int frame_count = hud->stats.count < FRAME_HUD_GRAPH_FRAMES
+                          ? hud->stats.count
+                          : FRAME_HUD_GRAPH_FRAMES;
+    for (int i = 0; i < frame_count; i++) {
+        float time = FrameStatsGet(&hud->stats, i)->frame;
+        float height = fminf(time * scale, FRAME_HUD_GRAPH_HEIGHT);
+        Color color = RED;
+        if (time <= budget * 1.05f) {
+            color = LIME;
+        } else if (time <= budget * 2.0f) {
+            color = ORANGE;
+        }
+        DrawRectangle((FRAME_HUD_GRAPH_FRAMES - 1 - i) * 2, bottom - height, 2,
+                      height, color);
+    }
+    DrawLine(0, bottom - budget * scale, FRAME_HUD_GRAPH_FRAMES * 2,
+             bottom - budget * scale, WHITE);
+
+    DrawText(TextFormat("%d frames  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms",
+                        summary->frame_count, summary->p50 * 1e3f,
+                        summary->p95 * 1e3f, summary->p99 * 1e3f,
+                        summary->max * 1e3f),
+             4, bottom + 6, 20, RAYWHITE);
+    char phases[128] = "";
+    int length = 0;
+    for (int phase = 0; phase < FRAME_PHASE_COUNT; phase++) {
+        length += snprintf(phases + length, sizeof(phases) - length,
+                           "%s %.2f  ", FramePhaseGetName(phase),
+                           summary->phase_means[phase] * 1e3f);
+    }
+    DrawText(TextFormat("%sms on average", phases), 4, bottom + 32, 20,
+             RAYWHITE);
+    const SoundPoolStats *sounds = &hud->sounds;
+    DrawText(TextFormat("%d voices  peak %d  stolen %d  merged %d  dropped %d",
+                        sounds->active_voices, sounds->peak_voices,
+                        sounds->stolen, sounds->merged, sounds->dropped),
+             4, bottom + 58, 20, RAYWHITE);
+}
+
+// draw_calls is how many it took to draw the screen, shown with DRAW_FPS.
+// Leaves presenting the frame with EndDrawing to the caller, so the blit and
+// the wait for vsync can be timed apart.
+void DrawScreenToWindow(RenderTexture2D screen, int draw_calls)
+{
+    PROFILE_BEGIN(DrawScreenToWindow);
     BeginDrawing();
     ClearBackground(BLACK);
     Rectangle source = {0, 0, (float)screen.texture.width,
@@ -878,9 +1982,15 @@ void DrawScreenToWindow(RenderTexture2D screen)
                    WHITE);
 #ifdef DRAW_FPS
     DrawFPS(0, 0);
+    DrawText(TextFormat("%d draw calls", draw_calls), 0, 20, 20, LIME);
+#else
+    (void)draw_calls;
 #endif /* ifdef DRAW_FPS */
-
-    EndDrawing();
+    if (frame_hud.shown) {
+        FrameHudDraw(&frame_hud);
+    }
+    rlDrawRenderBatchActive();
+    PROFILE_END(DrawScreenToWindow);
 }
 
 void SetFullscreen(bool fullscreen)
@@ -895,50 +2005,488 @@ void SetFullscreen(bool fullscreen)
     ToggleFullscreen();
 }
 
-int main(void)
+typedef struct {
+    int tick_rate;
+    const char *replay_path;
+    float playback_speed;
+    int host_port;
+    char connect_host[64];
+    int connect_port;
+    // Loopback network conditions, latency and jitter in milliseconds
+    bool loopback;
+    float loopback_latency;
+    float loopback_jitter;
+    float loopback_loss_percent;
+    SimSetup setup;
+    bool bot;
+    BotDifficulty bot_difficulty;
+    // Headless bot matches to run instead of opening the window
+    int batch_count;
+    int thread_count;
+    const char *output_path;
+    // Print how long startup took
+    bool startup_time;
+    // Where F4 and exiting write the profiling zones, with SPACEWAR_PROFILE
+    const char *trace_path;
+    // Cycles --soak plays itself through, 0 to play normally
+    int soak_cycles;
+    int music_buffer_ms;
+} Options;
+
+bool ParseOptions(Options *options, int argc, char **argv)
+{
+    *options = (Options){.tick_rate = SIM_DEFAULT_TICK_RATE,
+                         .setup = SIM_DUEL_SETUP,
+                         .playback_speed = 1.0f,
+                         .bot_difficulty = BOT_NORMAL,
+                         .thread_count = BatchGetCoreCount(),
+                         .music_buffer_ms = DEFAULT_MUSIC_BUFFER_MS};
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "--tick-rate") && i + 1 < argc) {
+            options->tick_rate = atoi(argv[++i]);
+            if (!SimTickRateSupported(options->tick_rate)) {
+                fprintf(stderr, "Tick rate must be 60, 120, 240 or 1000\n");
+                return false;
+            }
+        } else if (0 == strcmp(argv[i], "--replay") && i + 1 < argc) {
+            options->replay_path = argv[++i];
+        } else if (0 == strcmp(argv[i], "--speed") && i + 1 < argc) {
+            options->playback_speed = atof(argv[++i]);
+            if (options->playback_speed <= 0.0f) {
+                fprintf(stderr, "Playback speed must be positive\n");
+                return false;
+            }
+        } else if (0 == strcmp(argv[i], "--host") && i + 1 < argc) {
+            options->host_port = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--connect") && i + 1 < argc) {
+            if (2 != sscanf(argv[++i], "%63[^:]:%d", options->connect_host,
+                            &options->connect_port)) {
+                fprintf(stderr, "--connect expects HOST:PORT\n");
+                return false;
+            }
+        } else if (0 == strcmp(argv[i], "--loopback") && i + 1 < argc) {
+            options->loopback = true;
+            if (3 != sscanf(argv[++i], "%f:%f:%f", &options->loopback_latency,
+                            &options->loopback_jitter,
+                            &options->loopback_loss_percent)) {
+                fprintf(stderr, "--loopback expects LATENCY:JITTER:LOSS\n");
+                return false;
+            }
+        } else if (0 == strcmp(argv[i], "--ships") && i + 1 < argc) {
+            options->setup.ship_count = atoi(argv[++i]);
+            if (!SimSetupValid(options->setup)) {
+                fprintf(stderr, "--ships expects %d to %d ships\n",
+                        SIM_MIN_SHIPS, SIM_MAX_SHIPS);
+                return false;
+            }
+        } else if (0 == strcmp(argv[i], "--mode") && i + 1 < argc) {
+            if (!SimModeParse(argv[++i], &options->setup.mode)) {
+                fprintf(stderr, "--mode expects teams or ffa\n");
+                return false;
+            }
+        } else if (0 == strcmp(argv[i], "--bot") && i + 1 < argc) {
+            options->bot = true;
+            if (!BotDifficultyParse(argv[++i], &options->bot_difficulty)) {
+                fprintf(stderr, "--bot expects easy, normal or hard\n");
+                return false;
+            }
+        } else if (0 == strcmp(argv[i], "--batch") && i + 1 < argc) {
+            long count = strtol(argv[++i], NULL, 10);
+            if (count <= 0 || count > BATCH_MAX_MATCHES) {
+                fprintf(stderr, "--batch expects 1 to %d matches\n",
+                        BATCH_MAX_MATCHES);
+                return false;
+            }
+            options->batch_count = count;
+        } else if (0 == strcmp(argv[i], "--threads") && i + 1 < argc) {
+            options->thread_count = atoi(argv[++i]);
+            if (options->thread_count <= 0) {
+                fprintf(stderr, "--threads expects a number of threads\n");
+                return false;
+            }
+        } else if (0 == strcmp(argv[i], "--output") && i + 1 < argc) {
+            options->output_path = argv[++i];
+        } else if (0 == strcmp(argv[i], "--startup-time")) {
+            options->startup_time = true;
+        } else if (0 == strcmp(argv[i], "--trace") && i + 1 < argc) {
+            options->trace_path = argv[++i];
+        } else if (0 == strcmp(argv[i], "--soak") && i + 1 < argc) {
+            options->soak_cycles = atoi(argv[++i]);
+            if (options->soak_cycles <= 0) {
+                fprintf(stderr, "Soak cycles must be positive\n");
+                return false;
+            }
+        } else if (0 == strcmp(argv[i], "--music-buffer") && i + 1 < argc) {
+            options->music_buffer_ms = atoi(argv[++i]);
+            if (options->music_buffer_ms < 20) {
+                fprintf(stderr, "--music-buffer expects at least 20 ms\n");
+                return false;
+            }
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [--tick-rate HZ] [--replay FILE [--speed X]]\n"
+                    "       [--ships N] [--mode teams|ffa]\n"
+                    "       [--bot easy|normal|hard]\n"
+                    "       [--batch MATCHES [--threads T] [--output FILE]]\n"
+                    "       [--host PORT | --connect HOST:PORT |\n"
+                    "        --loopback LATENCY_MS:JITTER_MS:LOSS_PERCENT]\n"
+                    "       [--startup-time] [--trace FILE] [--soak CYCLES]\n"
+                    "       [--music-buffer MS]\n",
+                    argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sets up network play if any of its options were given
+bool OpenNetPlay(NetPlay *net, const Options *options, int tick_rate)
 {
+    if (options->loopback) {
+        return NetPlayOpenLoopback(net, options->loopback_latency / 1000.0f,
+                                   options->loopback_jitter / 1000.0f,
+                                   options->loopback_loss_percent / 100.0f,
+                                   tick_rate);
+    }
+    if ('\0' != options->connect_host[0]) {
+        return NetPlayOpenUdp(net, 0, options->connect_host,
+                              options->connect_port, tick_rate);
+    }
+    return NetPlayOpenUdp(net, options->host_port, NULL, 0, tick_rate);
+}
+
+double GetWallTime(void)
+{
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+typedef struct {
+    FILE *file;
+    SimSetup setup;
+    uint64_t ticks;
+} BatchOutput;
+
+// Flushed with every chunk, so an interrupted run keeps what it played
+void BatchOutputWrite(void *data, int first, const BatchResult *results,
+                      int count)
+{
+    BatchOutput *output = data;
+    BatchWriteCsvRows(output->file, output->setup, first, results, count);
+    fflush(output->file);
+    for (int i = 0; i < count; i++) {
+        output->ticks += results[i].ticks;
+    }
+}
+
+// Plays bot against bot without a window and writes one CSV row per match
+int RunBatch(const Options *options)
+{
+    BatchOptions batch = {.match_count = options->batch_count,
+                          .thread_count = options->thread_count,
+                          .tick_rate = options->tick_rate,
+                          .setup = options->setup,
+                          .first_seed = 1,
+                          .max_ticks = options->tick_rate * 300};
+    for (int i = 0; i < SIM_MAX_SHIPS; i++) {
+        batch.difficulties[i] = options->bot_difficulty;
+    }
+
+    BatchOutput output = {.file = stdout, .setup = batch.setup};
+    if (NULL != options->output_path) {
+        output.file = fopen(options->output_path, "w");
+        if (NULL == output.file) {
+            fprintf(stderr, "Could not write %s\n", options->output_path);
+            return 1;
+        }
+    }
+    BatchWriteCsvHeader(output.file, batch.setup);
+
+    double start = GetWallTime();
+    bool ran = BatchRun(&batch, &BatchOutputWrite, &output);
+    double elapsed = GetWallTime() - start;
+    if (stdout != output.file) {
+        fclose(output.file);
+    }
+    if (!ran) {
+        fprintf(stderr, "Not enough memory to run the matches\n");
+        return 1;
+    }
+
+    fprintf(stderr,
+            "%d matches on %d threads in %.2f s, %.0f matches/s, "
+            "%.0f ticks/s\n",
+            batch.match_count, batch.thread_count, elapsed,
+            batch.match_count / elapsed, output.ticks / elapsed);
+    return 0;
+}
+
+// Samples the resources and frame times of the cycle that just ended
+void SoakEndCycle(Soak *soak)
+{
+    soak->cycle++;
+    SoakSample sample = {.cycle = soak->cycle};
+    sample.values[SOAK_METRIC_RSS] = SoakGetResidentBytes();
+    sample.values[SOAK_METRIC_TEXTURES] = live_resources.textures;
+    sample.values[SOAK_METRIC_SOUNDS] = live_resources.sounds;
+    sample.values[SOAK_METRIC_FRAME_TIME] =
+        soak->frame_time_sum / (soak->frame_count > 0 ? soak->frame_count : 1);
+    SoakLogAdd(&soak->log, &sample);
+    if (0 == soak->cycle % SOAK_PROGRESS_CYCLES) {
+        fprintf(stderr,
+                "Soak cycle %d: %.1f MiB resident, %d textures, %d sounds, "
+                "%.2f ms per frame\n",
+                soak->cycle, sample.values[SOAK_METRIC_RSS] / (1024 * 1024),
+                live_resources.textures, live_resources.sounds,
+                sample.values[SOAK_METRIC_FRAME_TIME] * 1e3);
+    }
+    soak->frame_time_sum = 0.0;
+    soak->frame_count = 0;
+    soak->paused = false;
+    soak->rematch = false;
+}
+
+// Picks what the script clicks this frame, from the state the game is in
+void SoakScriptFrame(Soak *soak, const Game *game, const GameState *state)
+{
+    const Gui *gui = &game->gui;
+    soak->clicking = true;
+    if (&main_menu_state == state) {
+        if (soak->rematch) {
+            SoakEndCycle(soak);
+        }
+        soak->click = RectangleGetCenter(gui->main_menu_gui.play_button);
+    } else if (&playing_state == state) {
+        // Bots that cannot finish a match only end the cycle early
+        uint32_t second = game->tick_rate;
+        if (game->sim.tick >= second * SOAK_MAX_MATCH_SECONDS) {
+            soak->rematch = true;
+            soak->paused = false;
+        }
+        soak->clicking = !soak->paused && game->sim.tick >= second;
+        soak->paused = soak->paused || soak->clicking;
+        soak->click = RectangleGetCenter(
+            GetButtonRectangle(&gui->playing_gui.pause_button));
+    } else if (&pause_state == state) {
+        const TextButton *button = soak->rematch
+                                       ? &gui->pause_gui.main_menu_button
+                                       : &gui->pause_gui.resume_button;
+        soak->click = button->center;
+    } else if (&win_state == state) {
+        soak->rematch = true;
+        soak->paused = false;
+        soak->click = RectangleGetCenter(gui->win_gui.play_again_button);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    double start_time = GetWallTime();
+    Options options;
+    if (!ParseOptions(&options, argc, argv)) {
+        return 1;
+    }
+    if (options.batch_count > 0) {
+        int status = RunBatch(&options);
+        if (NULL != options.trace_path) {
+            ProfileWriteTrace(options.trace_path);
+        }
+        ProfileShutdown();
+        return status;
+    }
+
+    Game game = {.setup = options.setup,
+                 .tick_rate = options.tick_rate,
+                 .playback_speed = options.playback_speed,
+                 .bot_difficulty = options.bot_difficulty,
+                 .music_buffer_time = options.music_buffer_ms / 1000.0f};
+    if (!SimInit(&game.sim, SIM_DEFAULT_BULLET_CAPACITY) ||
+        !SimInit(&game.quick_save, SIM_DEFAULT_BULLET_CAPACITY)) {
+        fprintf(stderr, "Not enough memory for the match\n");
+        return 1;
+    }
+    if (NULL != options.replay_path) {
+        if (!ReplayOpen(&game.replay, options.replay_path)) {
+            fprintf(stderr, "%s is not a replay of this version of the game\n",
+                    options.replay_path);
+            return 1;
+        }
+        game.tick_rate = game.replay.header.tick_rate;
+    }
+
+    NetPlay net_play;
+    bool net_play_requested = options.loopback || options.host_port ||
+                              '\0' != options.connect_host[0];
+    if (options.bot && (net_play_requested || NULL != options.replay_path)) {
+        fprintf(stderr, "--bot only works in local matches\n");
+        return 1;
+    }
+    bool duel = 2 == options.setup.ship_count &&
+                SIM_MODE_TEAMS == options.setup.mode;
+    if (net_play_requested && !duel) {
+        fprintf(stderr, "Network matches are two ships, one per side\n");
+        return 1;
+    }
+    game.has_bot = options.bot;
+    if (options.soak_cycles > 0) {
+        if (net_play_requested || NULL != options.replay_path) {
+            fprintf(stderr, "--soak only works in local matches\n");
+            return 1;
+        }
+        soak = (Soak){.active = true, .cycle_count = options.soak_cycles};
+        SoakLogInit(&soak.log);
+        game.playback_speed *= SOAK_PLAYBACK_SPEED;
+    }
+    if (net_play_requested && NULL == options.replay_path) {
+        if (!OpenNetPlay(&net_play, &options, game.tick_rate)) {
+            fprintf(stderr, "Could not open a network connection\n");
+            return 1;
+        }
+        net_play.session.replay_writer = &game.replay_writer;
+        game.net = &net_play;
+    }
+
     SetTraceLogLevel(LOG_WARNING);
 
-    SetConfigFlags(FLAG_WINDOW_RESIZABLE | FLAG_VSYNC_HINT);
+    // Soaking runs as many frames as it can
+    SetConfigFlags(FLAG_WINDOW_RESIZABLE |
+                   (soak.active ? 0 : FLAG_VSYNC_HINT));
     InitWindow(INITIAL_WINDOW_WIDTH, INITIAL_WINDOW_HEIGHT, "Space War");
-    SetTargetFPS(GetMonitorRefreshRate(GetCurrentMonitor()));
+    SetTargetFPS(soak.active ? 0
+                             : GetMonitorRefreshRate(GetCurrentMonitor()));
     InitAudioDevice();
     SetExitKey(KEY_NULL);
+    double window_time = GetWallTime();
 
-    Image window_icon = LoadImage(WINDOW_ICON_FILEPATH);
+    AssetSource *assets = &game.resources.assets;
+    AssetSourceOpen(assets);
+    Image window_icon = AssetSourceLoadImage(assets, WINDOW_ICON_FILEPATH);
     SetWindowIcon(window_icon);
     UnloadImage(window_icon);
 
-    RenderTexture2D screen = LoadRenderTexture(SCREEN_WIDTH, SCREEN_HEIGHT);
-    Game game = {0};
-    GameInit(&game);
+    RenderTexture2D screen =
+        LoadRenderTextureCounted(SCREEN_WIDTH, SCREEN_HEIGHT);
+    UiLayerLoad(&ui_layer);
+    frozen_frame = LoadRenderTextureCounted(SCREEN_WIDTH, SCREEN_HEIGHT);
+    // Never fills up and flushes behind frame_draw_calls' back
+    render_batch = rlLoadRenderBatch(1, RENDER_BATCH_ELEMENTS);
+    rlSetRenderBatchActive(&render_batch);
+    if (!GameInit(&game)) {
+        fprintf(stderr, "Could not build the sprite atlas\n");
+        return 1;
+    }
+    double assets_time = GetWallTime();
+    bool first_frame = true;
 
     GameStatesInit();
     GameState *current_state = &main_menu_state;
     GameState *previous_state = NULL;
 
     while (NULL != current_state) {
+        double frame_start = GetTime();
         if (IsKeyPressed(KEY_F11)) {
             SetFullscreen(!IsWindowFullscreen());
         }
+        if (IsKeyPressed(KEY_F3)) {
+            frame_hud.shown = !frame_hud.shown;
+            frame_hud.summary_time = 0.0;
+        }
+        if (IsKeyPressed(KEY_F4)) {
+            const char *path = NULL != options.trace_path
+                                   ? options.trace_path
+                                   : DEFAULT_TRACE_FILENAME;
+            if (ProfileWriteTrace(path)) {
+                fprintf(stderr, "Wrote the profiling zones to %s\n", path);
+            }
+        }
 
+        // Counts the cached layers redrawn this frame too, by state changes
+        // and UiLayerUpdate
+        frame_draw_calls = 0;
         // Run game state initialization function on state change
         if (previous_state != current_state) {
             current_state->Init(&game);
             previous_state = current_state;
         }
 
+        UiLayerUpdate(&ui_layer, &game);
         BeginTextureMode(screen);
         current_state->Draw(&game);
+        FlushDrawCalls();
+        int draw_calls = frame_draw_calls;
         EndTextureMode();
 
-        DrawScreenToWindow(screen);
+        double draw_end = GetTime();
+        DrawScreenToWindow(screen, draw_calls);
+        double blit_end = GetTime();
+        EndDrawing();
+        double present_end = GetTime();
+        if (first_frame && options.startup_time) {
+            double now = GetWallTime();
+            fprintf(stderr,
+                    "Window %.1f ms, assets from %s %.1f ms, first frame "
+                    "%.1f ms, %.1f ms in total\n",
+                    (window_time - start_time) * 1e3,
+                    AssetSourceGetName(assets),
+                    (assets_time - window_time) * 1e3,
+                    (now - assets_time) * 1e3, (now - start_time) * 1e3);
+        }
+        first_frame = false;
 
         float deltatime = GetFrameTime();
+        game.input_time = 0.0;
+        if (soak.active) {
+            SoakScriptFrame(&soak, &game, current_state);
+        }
         current_state = current_state->Update(&game, deltatime);
+        double update_end = GetTime();
+
+        FrameSample sample = {.frame = update_end - frame_start};
+        sample.phases[FRAME_PHASE_INPUT] = game.input_time;
+        sample.phases[FRAME_PHASE_UPDATE] =
+            update_end - present_end - game.input_time;
+        sample.phases[FRAME_PHASE_DRAW] = draw_end - frame_start;
+        sample.phases[FRAME_PHASE_BLIT] = blit_end - draw_end;
+        sample.phases[FRAME_PHASE_PRESENT] = present_end - blit_end;
+        FrameHudAdd(&frame_hud, &sample);
+        SoundPoolUpdate(&game.resources.sounds);
+        frame_hud.sounds = game.resources.sounds.stats;
+        if (soak.active) {
+            soak.frame_time_sum += sample.frame;
+            soak.frame_count++;
+            if (soak.cycle >= soak.cycle_count) {
+                current_state = NULL;
+            }
+        }
     }
 
     GameDeinit(&game);
-    UnloadRenderTexture(screen);
-    return 0;
+    if (NULL != game.net) {
+        NetPlayClose(game.net);
+    }
+    if (NULL != options.trace_path) {
+        ProfileWriteTrace(options.trace_path);
+    }
+    ProfileShutdown();
+    UiLayerUnload(&ui_layer);
+    UnloadRenderTextureCounted(frozen_frame);
+    UnloadRenderTextureCounted(screen);
+    rlSetRenderBatchActive(NULL);
+    rlUnloadRenderBatch(render_batch);
+    CloseAudioDevice();
+    CloseWindow();
+
+    if (!soak.active) {
+        return 0;
+    }
+    bool soak_ok = SoakLogCheck(&soak.log, stderr);
+    if (0 != live_resources.textures || 0 != live_resources.sounds) {
+        fprintf(stderr, "%d textures and %d sounds still loaded at exit\n",
+                live_resources.textures, live_resources.sounds);
+        soak_ok = false;
+    }
+    fprintf(stderr, "Soak of %d cycles %s\n", soak.cycle,
+            soak_ok ? "passed" : "FAILED");
+    return soak_ok ? 0 : 1;
 }
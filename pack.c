@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "spacewar_archive.h"
+
+// Packs assets into the archive the game loads them from, built as
+// spacewar_pack:
+//   spacewar_pack assets.swpak assets/*.png assets/*.wav assets/*.ogg
+// With --c-source the archive is also written out as a C array, to compile
+// into the game with -DEMBED_ASSETS.
+
+#define C_SOURCE_BYTES_PER_LINE 16
+
+static bool WriteCSource(const char *path, const char *archive_path)
+{
+    MappedFile archive;
+    if (!MappedFileOpen(&archive, archive_path)) {
+        fprintf(stderr, "Could not read %s\n", archive_path);
+        return false;
+    }
+    FILE *file = fopen(path, "w");
+    if (NULL == file) {
+        fprintf(stderr, "Could not write %s\n", path);
+        MappedFileClose(&archive);
+        return false;
+    }
+
+    fprintf(file,
+            "// Generated by spacewar_pack from %s, do not edit\n\n"
+            "#include <stddef.h>\n\n"
+            "_Alignas(%d) const unsigned char EMBEDDED_ASSETS[] = {",
+            archive_path, ARCHIVE_ALIGNMENT);
+    for (size_t i = 0; i < archive.size; i++) {
+        fputs(0 == i % C_SOURCE_BYTES_PER_LINE ? "\n   " : "", file);
+        fprintf(file, " %d,", archive.data[i]);
+    }
+    fprintf(file, "\n};\nconst size_t EMBEDDED_ASSETS_SIZE = %zu;\n",
+            archive.size);
+    bool written = 0 == fclose(file);
+    MappedFileClose(&archive);
+    if (!written) {
+        fprintf(stderr, "Could not write %s\n", path);
+    }
+    return written;
+}
+
+int main(int argc, char **argv)
+{
+    const char *c_source_path = NULL;
+    int first = 1;
+    if (argc > 2 && 0 == strcmp(argv[1], "--c-source")) {
+        c_source_path = argv[2];
+        first = 3;
+    }
+    if (argc - first < 2) {
+        fprintf(stderr, "Usage: %s [--c-source FILE.c] ARCHIVE FILE...\n",
+                argv[0]);
+        return 1;
+    }
+    const char *archive_path = argv[first];
+    const char *const *paths = (const char *const *)argv + first + 1;
+    int count = argc - first - 1;
+    if (!ArchiveWrite(archive_path, paths, count)) {
+        return 1;
+    }
+    if (NULL != c_source_path && !WriteCSource(c_source_path, archive_path)) {
+        return 1;
+    }
+    printf("Packed %d files into %s\n", count, archive_path);
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spacewar_archive.h"
+
+static const unsigned char ARCHIVE_MAGIC[4] = {'S', 'W', 'P', 'K'};
+
+static void WriteU16(unsigned char *bytes, uint32_t value)
+{
+    bytes[0] = value & 0xFF;
+    bytes[1] = (value >> 8) & 0xFF;
+}
+
+static void WriteU32(unsigned char *bytes, uint32_t value)
+{
+    WriteU16(bytes, value & 0xFFFF);
+    WriteU16(bytes + 2, value >> 16);
+}
+
+static uint32_t ReadU16(const unsigned char *bytes)
+{
+    return bytes[0] | (uint32_t)bytes[1] << 8;
+}
+
+static uint32_t ReadU32(const unsigned char *bytes)
+{
+    return ReadU16(bytes) | ReadU16(bytes + 2) << 16;
+}
+
+static const unsigned char *ArchiveGetEntry(const Archive *archive, int index)
+{
+    return archive->data + ARCHIVE_HEADER_SIZE +
+           (size_t)index * ARCHIVE_ENTRY_SIZE;
+}
+
+// Checks the header and that every entry lies within the data
+static bool ArchiveValidate(Archive *archive)
+{
+    if (archive->size < ARCHIVE_HEADER_SIZE ||
+        0 != memcmp(archive->data, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) ||
+        ARCHIVE_VERSION != ReadU16(archive->data + 4)) {
+        return false;
+    }
+    archive->entry_count = ReadU16(archive->data + 6);
+    size_t index_end = ARCHIVE_HEADER_SIZE +
+                       (size_t)archive->entry_count * ARCHIVE_ENTRY_SIZE;
+    if (index_end > archive->size) {
+        return false;
+    }
+    for (int i = 0; i < archive->entry_count; i++) {
+        const unsigned char *entry = ArchiveGetEntry(archive, i);
+        size_t offset = ReadU32(entry + ARCHIVE_NAME_SIZE);
+        size_t size = ReadU32(entry + ARCHIVE_NAME_SIZE + 4);
+        if ('\0' != entry[ARCHIVE_NAME_SIZE - 1] || offset < index_end ||
+            offset > archive->size || size > archive->size - offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ArchiveOpen(Archive *archive, const char *path)
+{
+    *archive = (Archive){0};
+    if (!MappedFileOpen(&archive->file, path)) {
+        return false;
+    }
+    archive->data = archive->file.data;
+    archive->size = archive->file.size;
+    if (!ArchiveValidate(archive)) {
+        ArchiveClose(archive);
+        return false;
+    }
+    return true;
+}
+
+bool ArchiveOpenMemory(Archive *archive, const unsigned char *data,
+                       size_t size)
+{
+    *archive = (Archive){.data = data, .size = size};
+    if (!ArchiveValidate(archive)) {
+        *archive = (Archive){0};
+        return false;
+    }
+    return true;
+}
+
+void ArchiveClose(Archive *archive)
+{
+    MappedFileClose(&archive->file);
+    *archive = (Archive){0};
+}
+
+const unsigned char *ArchiveFind(const Archive *archive, const char *name,
+                                 size_t *size)
+{
+    for (int i = 0; i < archive->entry_count; i++) {
+        const unsigned char *entry = ArchiveGetEntry(archive, i);
+        if (0 == strcmp((const char *)entry, name)) {
+            *size = ReadU32(entry + ARCHIVE_NAME_SIZE + 4);
+            return archive->data + ReadU32(entry + ARCHIVE_NAME_SIZE);
+        }
+    }
+    return NULL;
+}
+
+// Reads the whole file at path into a new buffer, NULL on failure
+static unsigned char *ReadWholeFile(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (NULL == file) {
+        return NULL;
+    }
+    unsigned char *data = NULL;
+    long length = -1;
+    if (0 == fseek(file, 0, SEEK_END)) {
+        length = ftell(file);
+    }
+    if (length >= 0 && 0 == fseek(file, 0, SEEK_SET)) {
+        data = malloc(length > 0 ? length : 1);
+    }
+    if (NULL != data && (size_t)length != fread(data, 1, length, file)) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *size = length;
+    return data;
+}
+
+bool ArchiveWrite(const char *path, const char *const *paths, int count)
+{
+    if (count > ARCHIVE_MAX_ENTRIES) {
+        fprintf(stderr, "An archive holds at most %d files\n",
+                ARCHIVE_MAX_ENTRIES);
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        if (strlen(paths[i]) >= ARCHIVE_NAME_SIZE) {
+            fprintf(stderr, "%s is longer than %d characters\n", paths[i],
+                    ARCHIVE_NAME_SIZE - 1);
+            return false;
+        }
+    }
+    FILE *file = fopen(path, "wb");
+    if (NULL == file) {
+        fprintf(stderr, "Could not write %s\n", path);
+        return false;
+    }
+
+    unsigned char header[ARCHIVE_HEADER_SIZE];
+    memcpy(header, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    WriteU16(header + 4, ARCHIVE_VERSION);
+    WriteU16(header + 6, count);
+    fwrite(header, 1, sizeof(header), file);
+
+    // The index is written first with every size zero, then rewritten once
+    // the sizes are known
+    size_t offset = ARCHIVE_HEADER_SIZE + (size_t)count * ARCHIVE_ENTRY_SIZE;
+    unsigned char index[ARCHIVE_MAX_ENTRIES][ARCHIVE_ENTRY_SIZE] = {{0}};
+    fwrite(index, ARCHIVE_ENTRY_SIZE, count, file);
+
+    bool written = true;
+    for (int i = 0; written && i < count; i++) {
+        size_t size;
+        unsigned char *data = ReadWholeFile(paths[i], &size);
+        if (NULL == data) {
+            fprintf(stderr, "Could not read %s\n", paths[i]);
+            written = false;
+            break;
+        }
+        static const unsigned char padding[ARCHIVE_ALIGNMENT] = {0};
+        size_t padding_size = -offset % ARCHIVE_ALIGNMENT;
+        fwrite(padding, 1, padding_size, file);
+        offset += padding_size;
+
+        strcpy((char *)index[i], paths[i]);
+        WriteU32(index[i] + ARCHIVE_NAME_SIZE, offset);
+        WriteU32(index[i] + ARCHIVE_NAME_SIZE + 4, size);
+        written = size == fwrite(data, 1, size, file);
+        offset += size;
+        free(data);
+    }
+
+    written = written && 0 == fseek(file, ARCHIVE_HEADER_SIZE, SEEK_SET) &&
+              (size_t)count == fwrite(index, ARCHIVE_ENTRY_SIZE, count, file);
+    written = 0 == fclose(file) && written;
+    if (!written) {
+        fprintf(stderr, "Could not write %s\n", path);
+        remove(path);
+    }
+    return written;
+}
@@ -0,0 +1,47 @@
+#ifndef SPACEWAR_ARCHIVE_H
+#define SPACEWAR_ARCHIVE_H
+
+// Every asset packed into one file with an index, so the game opens and maps
+// a single file at startup and decodes assets straight from memory.
+//
+// File layout, little endian:
+//   "SWPK", u16 version, u16 entry count
+//   then per entry its path NUL padded to ARCHIVE_NAME_SIZE bytes, u32 offset
+//   from the start of the file and u32 size
+//   then the contents of every entry, each starting ARCHIVE_ALIGNMENT aligned
+
+#include <stddef.h>
+
+#include "spacewar_file.h"
+
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_HEADER_SIZE 8
+#define ARCHIVE_NAME_SIZE 56
+#define ARCHIVE_ENTRY_SIZE (ARCHIVE_NAME_SIZE + 8)
+#define ARCHIVE_ALIGNMENT 16
+#define ARCHIVE_MAX_ENTRIES 256
+
+typedef struct {
+    // Only mapped when opened from a file
+    MappedFile file;
+    const unsigned char *data;
+    size_t size;
+    int entry_count;
+} Archive;
+
+// Maps path and checks every entry lies within it
+bool ArchiveOpen(Archive *archive, const char *path);
+// Opens an archive already in memory, like one compiled into the executable.
+// data must stay valid until the archive is closed.
+bool ArchiveOpenMemory(Archive *archive, const unsigned char *data,
+                       size_t size);
+void ArchiveClose(Archive *archive);
+// Returns the contents of the entry called name, which stay valid until the
+// archive is closed, or NULL if there is none
+const unsigned char *ArchiveFind(const Archive *archive, const char *name,
+                                 size_t *size);
+
+// Packs the files at paths into an archive at path, under the same names
+bool ArchiveWrite(const char *path, const char *const *paths, int count);
+
+#endif /* ifndef SPACEWAR_ARCHIVE_H */
@@ -0,0 +1,138 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#define _DEFAULT_SOURCE
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "spacewar_audio_thread.h"
+
+struct AudioThread {
+    AudioThreadUpdate update;
+    void *data;
+    double period;
+    atomic_bool stopping;
+#ifdef _WIN32
+    HANDLE handle;
+    CRITICAL_SECTION lock;
+#else
+    pthread_t handle;
+    pthread_mutex_t lock;
+#endif
+};
+
+static void AudioThreadSleep(double seconds)
+{
+#ifdef _WIN32
+    DWORD milliseconds = (DWORD)(seconds * 1000.0);
+    Sleep(milliseconds > 0 ? milliseconds : 1);
+#else
+    struct timespec duration = {.tv_sec = (time_t)seconds};
+    duration.tv_nsec = (long)((seconds - duration.tv_sec) * 1e9);
+    nanosleep(&duration, NULL);
+#endif
+}
+
+static void AudioThreadRun(AudioThread *thread)
+{
+    while (!atomic_load_explicit(&thread->stopping, memory_order_relaxed)) {
+        AudioThreadLock(thread);
+        thread->update(thread->data);
+        AudioThreadUnlock(thread);
+        AudioThreadSleep(thread->period);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI AudioThreadMain(LPVOID thread)
+{
+    AudioThreadRun(thread);
+    return 0;
+}
+#else
+static void *AudioThreadMain(void *thread)
+{
+    AudioThreadRun(thread);
+    return NULL;
+}
+#endif
+
+AudioThread *AudioThreadStart(AudioThreadUpdate update, void *data,
+                              double period)
+{
+    AudioThread *thread = calloc(1, sizeof(*thread));
+    if (NULL == thread) {
+        return NULL;
+    }
+    thread->update = update;
+    thread->data = data;
+    thread->period = period;
+    atomic_init(&thread->stopping, false);
+#ifdef _WIN32
+    InitializeCriticalSection(&thread->lock);
+    thread->handle = CreateThread(NULL, 0, AudioThreadMain, thread, 0, NULL);
+    if (NULL == thread->handle) {
+        DeleteCriticalSection(&thread->lock);
+        free(thread);
+        return NULL;
+    }
+#else
+    if (0 != pthread_mutex_init(&thread->lock, NULL)) {
+        free(thread);
+        return NULL;
+    }
+    if (0 != pthread_create(&thread->handle, NULL, AudioThreadMain, thread)) {
+        pthread_mutex_destroy(&thread->lock);
+        free(thread);
+        return NULL;
+    }
+#endif
+    return thread;
+}
+
+void AudioThreadStop(AudioThread *thread)
+{
+    if (NULL == thread) {
+        return;
+    }
+    atomic_store_explicit(&thread->stopping, true, memory_order_relaxed);
+#ifdef _WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    DeleteCriticalSection(&thread->lock);
+#else
+    pthread_join(thread->handle, NULL);
+    pthread_mutex_destroy(&thread->lock);
+#endif
+    free(thread);
+}
+
+void AudioThreadLock(AudioThread *thread)
+{
+    if (NULL == thread) {
+        return;
+    }
+#ifdef _WIN32
+    EnterCriticalSection(&thread->lock);
+#else
+    pthread_mutex_lock(&thread->lock);
+#endif
+}
+
+void AudioThreadUnlock(AudioThread *thread)
+{
+    if (NULL == thread) {
+        return;
+    }
+#ifdef _WIN32
+    LeaveCriticalSection(&thread->lock);
+#else
+    pthread_mutex_unlock(&thread->lock);
+#endif
+}
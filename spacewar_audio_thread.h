@@ -0,0 +1,24 @@
+#ifndef SPACEWAR_AUDIO_THREAD_H
+#define SPACEWAR_AUDIO_THREAD_H
+
+// A thread that keeps calling an update function, so streamed audio is
+// decoded and refilled at its own pace however long the main loop takes over
+// a frame. Whatever else touches the data the update reads must take the lock
+// around it.
+
+typedef void (*AudioThreadUpdate)(void *data);
+
+typedef struct AudioThread AudioThread;
+
+// Calls update with data every period seconds under the lock, NULL if the
+// thread could not be started
+AudioThread *AudioThreadStart(AudioThreadUpdate update, void *data,
+                              double period);
+// Lets the update in progress, if any, finish, then ends the thread and
+// frees it
+void AudioThreadStop(AudioThread *thread);
+// Do nothing on NULL, so callers work the same without a thread
+void AudioThreadLock(AudioThread *thread);
+void AudioThreadUnlock(AudioThread *thread);
+
+#endif /* ifndef SPACEWAR_AUDIO_THREAD_H */
@@ -0,0 +1,364 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#define _DEFAULT_SOURCE
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "spacewar_batch.h"
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION BatchMutex;
+typedef CONDITION_VARIABLE BatchCondition;
+#else
+typedef pthread_mutex_t BatchMutex;
+typedef pthread_cond_t BatchCondition;
+#endif
+
+typedef struct {
+    const BatchOptions *options;
+    int chunk_count;
+    // Chunk c is played into slot c % BATCH_WINDOW_CHUNKS
+    BatchResult *window;
+    // Under lock: the chunk each slot holds once it is done, -1 before
+    int *done_chunks;
+    // Under lock: chunks handed to the caller, whose slots are free again
+    int handed_chunks;
+    BatchMutex lock;
+    // Signalled whenever a chunk is done or handed out
+    BatchCondition changed;
+    // Written by every thread, so it gets a cache line of its own
+    _Alignas(BATCH_CACHE_LINE_SIZE) atomic_int next_chunk;
+} BatchJob;
+
+// Everything a thread writes while playing, kept on its own stack and
+// aligned so no other thread's data shares its cache lines
+typedef struct {
+    _Alignas(BATCH_CACHE_LINE_SIZE) SimState sim;
+    BotInputSource bots[SIM_MAX_SHIPS];
+    InputSource *sources[SIM_MAX_SHIPS];
+} BatchWorker;
+
+int BatchGetCoreCount(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? count : 1;
+#endif
+}
+
+static BatchResult BatchWorkerRunMatch(BatchWorker *worker,
+                                       const BatchOptions *options,
+                                       uint32_t seed)
+{
+    SimState *sim = &worker->sim;
+    const int ship_count = options->setup.ship_count;
+    SimReset(sim, options->setup, seed);
+    for (int i = 0; i < ship_count; i++) {
+        worker->bots[i] = BotInputSourceCreate(options->difficulties[i],
+                                               options->tick_rate);
+        worker->sources[i] = &worker->bots[i].source;
+    }
+
+    float deltatime = 1.0f / options->tick_rate;
+    while (NONE == sim->winner && sim->tick < options->max_ticks) {
+        InputMask inputs[SIM_MAX_SHIPS];
+        InputSourcesSample(worker->sources, sim, inputs);
+        SimStep(sim, inputs, deltatime);
+    }
+
+    BatchResult result = {
+        .seed = seed, .ticks = sim->tick, .winner = sim->winner};
+    for (int i = 0; i < ship_count; i++) {
+        result.shots[i] = sim->ships[i].shots;
+        result.hits[i] = sim->ships[i].hits;
+        result.dashes[i] = sim->ships[i].dashes;
+    }
+    return result;
+}
+
+bool BatchRunMatch(const BatchOptions *options, uint32_t seed,
+                   BatchResult *result)
+{
+    BatchWorker worker;
+    if (!SimInit(&worker.sim, SIM_DEFAULT_BULLET_CAPACITY)) {
+        return false;
+    }
+    *result = BatchWorkerRunMatch(&worker, options, seed);
+    SimDeinit(&worker.sim);
+    return true;
+}
+
+#ifdef _WIN32
+static void BatchJobLock(BatchJob *job) { EnterCriticalSection(&job->lock); }
+
+static void BatchJobUnlock(BatchJob *job) { LeaveCriticalSection(&job->lock); }
+
+static void BatchJobWait(BatchJob *job)
+{
+    SleepConditionVariableCS(&job->changed, &job->lock, INFINITE);
+}
+
+static void BatchJobWakeAll(BatchJob *job)
+{
+    WakeAllConditionVariable(&job->changed);
+}
+#else
+static void BatchJobLock(BatchJob *job) { pthread_mutex_lock(&job->lock); }
+
+static void BatchJobUnlock(BatchJob *job) { pthread_mutex_unlock(&job->lock); }
+
+static void BatchJobWait(BatchJob *job)
+{
+    pthread_cond_wait(&job->changed, &job->lock);
+}
+
+static void BatchJobWakeAll(BatchJob *job)
+{
+    pthread_cond_broadcast(&job->changed);
+}
+#endif
+
+static int BatchJobGetChunkSize(const BatchJob *job, int chunk)
+{
+    int remaining = job->options->match_count - chunk * BATCH_CHUNK_MATCHES;
+    return remaining < BATCH_CHUNK_MATCHES ? remaining : BATCH_CHUNK_MATCHES;
+}
+
+static void BatchJobPlayChunk(BatchJob *job, BatchWorker *worker, int chunk)
+{
+    const BatchOptions *options = job->options;
+    int slot = chunk % BATCH_WINDOW_CHUNKS;
+    BatchResult *results = &job->window[slot * BATCH_CHUNK_MATCHES];
+    int first = chunk * BATCH_CHUNK_MATCHES;
+    int count = BatchJobGetChunkSize(job, chunk);
+    for (int i = 0; i < count; i++) {
+        results[i] = BatchWorkerRunMatch(worker, options,
+                                         options->first_seed + first + i);
+    }
+    BatchJobLock(job);
+    job->done_chunks[slot] = chunk;
+    BatchJobWakeAll(job);
+    BatchJobUnlock(job);
+}
+
+// Plays chunks until none are left, waiting when the window is full
+static void BatchJobWork(BatchJob *job)
+{
+    // A thread that cannot set up leaves its matches to the others
+    BatchWorker worker;
+    if (!SimInit(&worker.sim, SIM_DEFAULT_BULLET_CAPACITY)) {
+        return;
+    }
+    for (;;) {
+        int chunk = atomic_fetch_add_explicit(&job->next_chunk, 1,
+                                              memory_order_relaxed);
+        if (chunk >= job->chunk_count) {
+            break;
+        }
+        BatchJobLock(job);
+        while (chunk >= job->handed_chunks + BATCH_WINDOW_CHUNKS) {
+            BatchJobWait(job);
+        }
+        BatchJobUnlock(job);
+        BatchJobPlayChunk(job, &worker, chunk);
+    }
+    SimDeinit(&worker.sim);
+}
+
+// Whether the calling thread can play the next chunk without waiting for
+// room in the window, which only it makes
+static bool BatchJobHasRoom(BatchJob *job, int *chunk)
+{
+    *chunk = atomic_load_explicit(&job->next_chunk, memory_order_relaxed);
+    return *chunk < job->chunk_count &&
+           *chunk < job->handed_chunks + BATCH_WINDOW_CHUNKS;
+}
+
+// Hands out chunks in order as they are done, playing chunks too while the
+// next one to hand out is not done yet
+static void BatchJobHandOut(BatchJob *job, BatchWorker *worker,
+                            BatchResultsReady ready, void *data)
+{
+    while (job->handed_chunks < job->chunk_count) {
+        int chunk = job->handed_chunks;
+        int slot = chunk % BATCH_WINDOW_CHUNKS;
+        BatchJobLock(job);
+        bool done = chunk == job->done_chunks[slot];
+        BatchJobUnlock(job);
+        if (done) {
+            ready(data, chunk * BATCH_CHUNK_MATCHES,
+                  &job->window[slot * BATCH_CHUNK_MATCHES],
+                  BatchJobGetChunkSize(job, chunk));
+            BatchJobLock(job);
+            job->handed_chunks++;
+            BatchJobWakeAll(job);
+            BatchJobUnlock(job);
+            continue;
+        }
+
+        int next;
+        if (BatchJobHasRoom(job, &next)) {
+            if (atomic_compare_exchange_weak_explicit(
+                    &job->next_chunk, &next, next + 1, memory_order_relaxed,
+                    memory_order_relaxed)) {
+                BatchJobPlayChunk(job, worker, next);
+            }
+            continue;
+        }
+        BatchJobLock(job);
+        while (chunk != job->done_chunks[slot] &&
+               !BatchJobHasRoom(job, &next)) {
+            BatchJobWait(job);
+        }
+        BatchJobUnlock(job);
+    }
+}
+
+#ifdef _WIN32
+typedef HANDLE BatchThread;
+
+static DWORD WINAPI BatchThreadMain(LPVOID job)
+{
+    BatchJobWork(job);
+    return 0;
+}
+
+static bool BatchThreadStart(BatchThread *thread, BatchJob *job)
+{
+    *thread = CreateThread(NULL, 0, BatchThreadMain, job, 0, NULL);
+    return NULL != *thread;
+}
+
+static void BatchThreadJoin(BatchThread thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+#else
+typedef pthread_t BatchThread;
+
+static void *BatchThreadMain(void *job)
+{
+    BatchJobWork(job);
+    return NULL;
+}
+
+static bool BatchThreadStart(BatchThread *thread, BatchJob *job)
+{
+    return 0 == pthread_create(thread, NULL, BatchThreadMain, job);
+}
+
+static void BatchThreadJoin(BatchThread thread) { pthread_join(thread, NULL); }
+#endif
+
+bool BatchRun(const BatchOptions *options, BatchResultsReady ready,
+              void *data)
+{
+    if (options->match_count > BATCH_MAX_MATCHES) {
+        return false;
+    }
+    BatchJob job = {.options = options,
+                    .chunk_count = (options->match_count +
+                                    BATCH_CHUNK_MATCHES - 1) /
+                                   BATCH_CHUNK_MATCHES};
+    atomic_init(&job.next_chunk, 0);
+    job.window = malloc(BATCH_WINDOW_CHUNKS * BATCH_CHUNK_MATCHES *
+                        sizeof(*job.window));
+    job.done_chunks = malloc(BATCH_WINDOW_CHUNKS * sizeof(*job.done_chunks));
+    // The calling thread works too, so one fewer is started
+    int extra_count = options->thread_count - 1;
+    BatchThread *threads = NULL;
+    if (extra_count > 0) {
+        threads = malloc(extra_count * sizeof(*threads));
+    }
+    // The calling thread hands the results out, it must be able to play
+    // every match alone
+    BatchWorker worker;
+    if (NULL == job.window || NULL == job.done_chunks ||
+        (extra_count > 0 && NULL == threads) ||
+        !SimInit(&worker.sim, SIM_DEFAULT_BULLET_CAPACITY)) {
+        free(job.window);
+        free(job.done_chunks);
+        free(threads);
+        return false;
+    }
+    for (int i = 0; i < BATCH_WINDOW_CHUNKS; i++) {
+        job.done_chunks[i] = -1;
+    }
+#ifdef _WIN32
+    InitializeCriticalSection(&job.lock);
+    InitializeConditionVariable(&job.changed);
+#else
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.changed, NULL);
+#endif
+
+    int started = 0;
+    while (started < extra_count && BatchThreadStart(&threads[started], &job)) {
+        started++;
+    }
+    BatchJobHandOut(&job, &worker, ready, data);
+    for (int i = 0; i < started; i++) {
+        BatchThreadJoin(threads[i]);
+    }
+
+#ifdef _WIN32
+    DeleteCriticalSection(&job.lock);
+#else
+    pthread_cond_destroy(&job.changed);
+    pthread_mutex_destroy(&job.lock);
+#endif
+    SimDeinit(&worker.sim);
+    free(threads);
+    free(job.done_chunks);
+    free(job.window);
+    return true;
+}
+
+static void WinnerWrite(FILE *file, SimMode mode, Winner winner)
+{
+    if (DRAW == winner) {
+        fputs("draw", file);
+    } else if (NONE == winner) {
+        fputs("none", file);
+    } else if (SIM_MODE_TEAMS == mode) {
+        fputs(LEFT == winner ? "left" : "right", file);
+    } else {
+        fprintf(file, "%d", winner);
+    }
+}
+
+void BatchWriteCsvHeader(FILE *file, SimSetup setup)
+{
+    fprintf(file, "match,seed,winner,ticks");
+    for (int i = 0; i < setup.ship_count; i++) {
+        fprintf(file, ",shots%d,hits%d,dashes%d", i, i, i);
+    }
+    fputc('\n', file);
+}
+
+void BatchWriteCsvRows(FILE *file, SimSetup setup, int first,
+                       const BatchResult *results, int count)
+{
+    for (int i = 0; i < count; i++) {
+        const BatchResult *result = &results[i];
+        fprintf(file, "%d,%u,", first + i, result->seed);
+        WinnerWrite(file, setup.mode, result->winner);
+        fprintf(file, ",%u", result->ticks);
+        for (int j = 0; j < setup.ship_count; j++) {
+            fprintf(file, ",%u,%u,%u", result->shots[j], result->hits[j],
+                    result->dashes[j]);
+        }
+        fputc('\n', file);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef SPACEWAR_BATCH_H
+#define SPACEWAR_BATCH_H
+
+// Runs many headless bot matches across a pool of threads, for checking how
+// gameplay constants affect balance. Every match is independent and only
+// depends on its seed, so results are the same for any thread count.
+
+#include <limits.h>
+#include <stdio.h>
+
+#include "spacewar_bot.h"
+#include "spacewar_sim.h"
+
+// Assumed size of a cache line, per-thread data is aligned to it so threads
+// never write to the same line
+#define BATCH_CACHE_LINE_SIZE 64
+// Matches a thread claims at once, so the shared counter is rarely touched
+// and neighbouring results are mostly written by the same thread
+#define BATCH_CHUNK_MATCHES 64
+// Chunks whose results are held at once. Threads only start a chunk this
+// close to the oldest one not handed out yet, so memory stays the same
+// however many matches run.
+#define BATCH_WINDOW_CHUNKS 256
+// So chunk claims never overflow the match counter
+#define BATCH_MAX_MATCHES (INT_MAX - BATCH_CHUNK_MATCHES * 2)
+
+typedef struct {
+    int match_count;
+    int thread_count;
+    int tick_rate;
+    SimSetup setup;
+    BotDifficulty difficulties[SIM_MAX_SHIPS];
+    // Match i is played with seed first_seed + i
+    uint32_t first_seed;
+    // Matches still running after this many ticks end without a winner
+    uint32_t max_ticks;
+} BatchOptions;
+
+typedef struct {
+    uint32_t seed;
+    uint32_t ticks;
+    Winner winner;
+    uint32_t shots[SIM_MAX_SHIPS];
+    uint32_t hits[SIM_MAX_SHIPS];
+    uint32_t dashes[SIM_MAX_SHIPS];
+} BatchResult;
+
+int BatchGetCoreCount(void);
+bool BatchRunMatch(const BatchOptions *options, uint32_t seed,
+                   BatchResult *result);
+// Called on the thread that called BatchRun with the results of matches
+// first to first + count - 1
+typedef void (*BatchResultsReady)(void *data, int first,
+                                  const BatchResult *results, int count);
+// Hands out the results in match order, each chunk as soon as it and every
+// chunk before it are done. Returns false if the matches could not be set up
+// or there are more than BATCH_MAX_MATCHES.
+bool BatchRun(const BatchOptions *options, BatchResultsReady ready,
+              void *data);
+// Writes the columns of the ship count of setup
+void BatchWriteCsvHeader(FILE *file, SimSetup setup);
+// The winner is "left" or "right" in team matches and the index of the
+// winning ship in free for all
+void BatchWriteCsvRows(FILE *file, SimSetup setup, int first,
+                       const BatchResult *results, int count);
+
+#endif /* ifndef SPACEWAR_BATCH_H */
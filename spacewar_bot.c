@@ -0,0 +1,238 @@
+#include <math.h>
+#include <string.h>
+
+#define RAYMATH_STATIC_INLINE
+#include "spacewar_bot.h"
+
+typedef struct {
+    const char *name;
+    float reaction_time;
+    // Largest vertical distance to the enemy the bot still shoots at
+    float aim_tolerance;
+    // Chance to miss a shot or a dodge it should have seen
+    float error_chance;
+    // How far ahead in seconds incoming bullets get dodged
+    float dodge_horizon;
+    bool dashes;
+    // Preferred distance from the middle of the screen
+    float distance;
+} BotSettings;
+
+static const BotSettings BOT_SETTINGS[BOT_DIFFICULTY_COUNT] = {
+    [BOT_EASY] = {"easy", 0.25f, 10.0f, 0.4f, 0.25f, false, 170.0f},
+    [BOT_NORMAL] = {"normal", 0.12f, 7.0f, 0.15f, 0.4f, true, 130.0f},
+    [BOT_HARD] = {"hard", 0.05f, 5.0f, 0.03f, 0.6f, true, 100.0f},
+};
+
+// Extra room kept between a dodged bullet and the hitbox
+static const float BOT_DODGE_MARGIN = 4.0f;
+
+bool BotDifficultyParse(const char *name, BotDifficulty *difficulty)
+{
+    for (int i = 0; i < BOT_DIFFICULTY_COUNT; i++) {
+        if (0 == strcmp(name, BOT_SETTINGS[i].name)) {
+            *difficulty = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *BotDifficultyGetName(BotDifficulty difficulty)
+{
+    return BOT_SETTINGS[difficulty].name;
+}
+
+// Random number in [0, 1) that only depends on the match, the tick and the
+// player, so a bot decides the same way whenever a tick is run again
+static float BotRandom(const SimState *sim, int player, uint32_t salt)
+{
+    uint32_t x = sim->seed ^ (sim->tick * 0x9E3779B9u) ^
+                 ((uint32_t)player << 24) ^ (salt * 0x85EBCA6Bu);
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return (x >> 8) / 16777216.0f;
+}
+
+static float ShipGetCenterY(const Ship *ship)
+{
+    return ship->position.y + SHIP_HEIGHT / 2.0f;
+}
+
+// Finds the enemy bullet that will hit ship soonest. Returns its time to
+// impact in seconds, or INFINITY if none is coming within horizon.
+static float BotFindThreat(const SimState *sim, int player, float horizon,
+                           float *threat_y)
+{
+    const Ship *ship = &sim->ships[player];
+    const BulletPool *bullets = &sim->bullets;
+    Rectangle hitbox = ShipGetHitbox(ship);
+    float soonest = INFINITY;
+    int scanned = 0;
+    for (int i = 0; i < bullets->count; i++) {
+        if (sim->ships[bullets->owner[i]].team == ship->team) {
+            continue;
+        }
+        if (++scanned > BOT_MAX_SCANNED_BULLETS) {
+            break;
+        }
+
+        float y = bullets->y[i] + BULLET_HEIGHT / 2.0f;
+        if (y < hitbox.y - BOT_DODGE_MARGIN ||
+            y > hitbox.y + hitbox.height + BOT_DODGE_MARGIN) {
+            continue;
+        }
+        // Negative once the bullet has flown past
+        float distance = bullets->direction[i] < 0.0f
+                             ? bullets->x[i] - (hitbox.x + hitbox.width)
+                             : hitbox.x - (bullets->x[i] + BULLET_WIDTH);
+        float time = distance / BULLET_VELOCITY;
+        if (distance < 0.0f || time > horizon || time >= soonest) {
+            continue;
+        }
+        soonest = time;
+        *threat_y = y;
+    }
+    return soonest;
+}
+
+// The closest ship still alive on another team, NULL if there is none
+static const Ship *BotFindEnemy(const SimState *sim, const Ship *ship)
+{
+    const Ship *closest = NULL;
+    float closest_distance = INFINITY;
+    for (int i = 0; i < sim->setup.ship_count; i++) {
+        const Ship *other = &sim->ships[i];
+        if (other->team == ship->team || !ShipIsAlive(other)) {
+            continue;
+        }
+        float distance = Vector2DistanceSqr(other->position, ship->position);
+        if (distance < closest_distance) {
+            closest = other;
+            closest_distance = distance;
+        }
+    }
+    return closest;
+}
+
+static void BotDecide(BotInputSource *bot, const SimState *sim, int player)
+{
+    const BotSettings *settings = &BOT_SETTINGS[bot->difficulty];
+    const Ship *ship = &sim->ships[player];
+    const Ship *enemy = BotFindEnemy(sim, ship);
+    float center_y = ShipGetCenterY(ship);
+
+    bot->has_decision = true;
+    bot->decision_tick = sim->tick;
+    bot->actions = 0;
+    bot->turn = 0;
+    if (NULL == enemy) {
+        bot->target = ship->position;
+        return;
+    }
+    if (SIM_MODE_TEAMS == sim->setup.mode) {
+        float middle = SCREEN_WIDTH / 2.0f - SHIP_WIDTH / 2.0f;
+        bot->target.x =
+            middle + (LEFT == ship->team ? -1 : 1) * settings->distance;
+    } else {
+        // Keep the distance on whichever side of the enemy the bot is
+        bool left_of_enemy = ship->position.x < enemy->position.x;
+        bot->target.x = Clamp(enemy->position.x +
+                                  (left_of_enemy ? -1 : 1) * settings->distance,
+                              0.0f, SCREEN_WIDTH - SHIP_WIDTH);
+    }
+
+    float threat_y = 0.0f;
+    float impact_time =
+        BotFindThreat(sim, player, settings->dodge_horizon, &threat_y);
+    bool notices_threat = BotRandom(sim, player, 0) >= settings->error_chance;
+    if (isfinite(impact_time) && notices_threat) {
+        // Move to whichever side of the bullet has more room
+        float clearance = SHIP_HITBOX_HEIGHT / 2.0f + BOT_DODGE_MARGIN;
+        float up_y = threat_y - clearance - SHIP_HITBOX_HEIGHT / 2.0f;
+        float down_y = threat_y + clearance + SHIP_HITBOX_HEIGHT / 2.0f;
+        bool go_up = up_y - SHIP_HEIGHT / 2.0f >= 0.0f &&
+                     (threat_y >= center_y ||
+                      down_y + SHIP_HEIGHT / 2.0f > SCREEN_HEIGHT);
+        float dodge_y = go_up ? up_y : down_y;
+        bot->target.y = dodge_y - SHIP_HEIGHT / 2.0f;
+
+        float move_time = fabsf(dodge_y - center_y) / SHIP_VELOCITY;
+        if (move_time > impact_time && settings->dashes &&
+            DEFAULT == ship->state && ship->dash_cooldown <= 0.0f) {
+            bot->actions |= INPUT_DASH;
+        }
+        return;
+    }
+
+    float aim_error = (BotRandom(sim, player, 1) * 2.0f - 1.0f) *
+                      settings->aim_tolerance;
+    bot->target.y = enemy->position.y + aim_error;
+    bool aligned = fabsf(ShipGetCenterY(enemy) - center_y) <=
+                   settings->aim_tolerance;
+    bool takes_shot = BotRandom(sim, player, 2) >= settings->error_chance;
+    if (aligned && takes_shot && ship->bullet_count < MAX_PLAYER_BULLETS) {
+        bot->actions |= INPUT_SHOOT;
+        // Ships turn where they move before shooting on the same tick
+        if (SIM_MODE_FREE_FOR_ALL == sim->setup.mode) {
+            bot->turn = (enemy->position.x < ship->position.x) ? INPUT_LEFT
+                                                                : INPUT_RIGHT;
+        }
+    }
+}
+
+static InputMask BotSteer(Vector2 target, const Ship *ship, float step)
+{
+    InputMask input = 0;
+    if (target.y < ship->position.y - step) {
+        input |= INPUT_UP;
+    } else if (target.y > ship->position.y + step) {
+        input |= INPUT_DOWN;
+    }
+    if (target.x < ship->position.x - step) {
+        input |= INPUT_LEFT;
+    } else if (target.x > ship->position.x + step) {
+        input |= INPUT_RIGHT;
+    }
+    return input;
+}
+
+static InputMask BotInputSourceSample(InputSource *source, const SimState *sim,
+                                      int player)
+{
+    BotInputSource *bot = (BotInputSource *)source;
+    const Ship *ship = &sim->ships[player];
+    // Ticks can run again after a rollback or a quick load
+    bool stale = !bot->has_decision || sim->tick < bot->decision_tick ||
+                 sim->tick - bot->decision_tick >= (uint32_t)bot->think_ticks;
+    if (stale) {
+        BotDecide(bot, sim, player);
+    }
+
+    // Closer than one tick of movement would only overshoot
+    float step = SHIP_VELOCITY / bot->tick_rate;
+    InputMask input = BotSteer(bot->target, ship, step);
+    if (sim->tick == bot->decision_tick) {
+        if (bot->actions & INPUT_DASH) {
+            // Dash straight away from the bullet
+            input &= ~(INPUT_LEFT | INPUT_RIGHT);
+        } else if (bot->turn) {
+            input = (input & ~(INPUT_LEFT | INPUT_RIGHT)) | bot->turn;
+        }
+        // Pressing needs the button released on the tick before
+        input |= bot->actions & ~ship->last_input;
+    }
+    return input;
+}
+
+BotInputSource BotInputSourceCreate(BotDifficulty difficulty, int tick_rate)
+{
+    int think_ticks = BOT_SETTINGS[difficulty].reaction_time * tick_rate;
+    return (BotInputSource){.source = {.Sample = &BotInputSourceSample},
+                            .difficulty = difficulty,
+                            .tick_rate = tick_rate,
+                            .think_ticks = think_ticks < 2 ? 2 : think_ticks};
+}
@@ -0,0 +1,49 @@
+#ifndef SPACEWAR_BOT_H
+#define SPACEWAR_BOT_H
+
+// Computer controlled player. A bot is an InputSource like the keyboard, so
+// it can only do what a player could: it looks at the match state, plans
+// where to go a few times per second and presses the same buttons.
+//
+// Deciding is a single pass over at most BOT_MAX_SCANNED_BULLETS bullets, well
+// under 50 microseconds, and steering between decisions is a few comparisons.
+// Bots only depend on the simulation, so they run headless as well.
+
+#include "spacewar_input.h"
+#include "spacewar_sim.h"
+
+// Bullets looked at per decision, bounding its cost however many are flying
+#define BOT_MAX_SCANNED_BULLETS 64
+
+typedef enum {
+    BOT_EASY,
+    BOT_NORMAL,
+    BOT_HARD,
+    BOT_DIFFICULTY_COUNT,
+} BotDifficulty;
+
+typedef struct {
+    InputSource source;
+    BotDifficulty difficulty;
+    int tick_rate;
+    // Ticks between decisions, the bot's reaction time
+    int think_ticks;
+
+    // Plan of the last decision, followed until the next one
+    bool has_decision;
+    uint32_t decision_tick;
+    Vector2 target;
+    // Shoot or dash, pressed on the decision tick only
+    InputMask actions;
+    // Left or right held on the decision tick to face the enemy before
+    // shooting, in free for all where ships turn
+    InputMask turn;
+} BotInputSource;
+
+BotInputSource BotInputSourceCreate(BotDifficulty difficulty, int tick_rate);
+
+// Parses "easy", "normal" or "hard", returns false for anything else
+bool BotDifficultyParse(const char *name, BotDifficulty *difficulty);
+const char *BotDifficultyGetName(BotDifficulty difficulty);
+
+#endif /* ifndef SPACEWAR_BOT_H */
@@ -0,0 +1,226 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spacewar_bullets.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BULLET_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+static const size_t BULLET_POOL_ALIGNMENT = 64;
+
+static size_t BulletPoolGetArraySize(size_t size)
+{
+    return (size + BULLET_POOL_ALIGNMENT - 1) / BULLET_POOL_ALIGNMENT *
+           BULLET_POOL_ALIGNMENT;
+}
+
+static int BulletGetGroupCount(int count)
+{
+    return (count + BULLET_REMOVAL_GROUP - 1) / BULLET_REMOVAL_GROUP;
+}
+
+bool BulletPoolInit(BulletPool *pool, int capacity)
+{
+    size_t float_size = BulletPoolGetArraySize(capacity * sizeof(float));
+    size_t owner_size = BulletPoolGetArraySize(capacity);
+    size_t removals_size =
+        BulletPoolGetArraySize(BulletGetGroupCount(capacity));
+    *pool = (BulletPool){.capacity = capacity, .kernel = BulletKernelDetect()};
+    pool->storage = calloc(1, 6 * float_size + owner_size + removals_size +
+                                  BULLET_POOL_ALIGNMENT);
+    if (NULL == pool->storage) {
+        return false;
+    }
+
+    unsigned char *next = pool->storage;
+    next += (BULLET_POOL_ALIGNMENT - (uintptr_t)next % BULLET_POOL_ALIGNMENT) %
+            BULLET_POOL_ALIGNMENT;
+    pool->x = (float *)next;
+    pool->y = (float *)(next += float_size);
+    pool->prev_x = (float *)(next += float_size);
+    pool->direction = (float *)(next += float_size);
+    pool->swept_x = (float *)(next += float_size);
+    pool->swept_width = (float *)(next += float_size);
+    pool->owner = (next += float_size);
+    pool->removals = next + owner_size;
+    return true;
+}
+
+void BulletPoolDeinit(BulletPool *pool)
+{
+    free(pool->storage);
+    *pool = (BulletPool){0};
+}
+
+void BulletPoolCopy(BulletPool *destination, const BulletPool *source)
+{
+    assert(destination->capacity >= source->count);
+    int count = destination->count = source->count;
+    size_t float_size = count * sizeof(float);
+    memcpy(destination->x, source->x, float_size);
+    memcpy(destination->y, source->y, float_size);
+    memcpy(destination->prev_x, source->prev_x, float_size);
+    memcpy(destination->direction, source->direction, float_size);
+    memcpy(destination->swept_x, source->swept_x, float_size);
+    memcpy(destination->swept_width, source->swept_width, float_size);
+    memcpy(destination->owner, source->owner, count);
+}
+
+void BulletPoolSwapRemove(BulletPool *pool, int index)
+{
+    int last = --pool->count;
+    pool->x[index] = pool->x[last];
+    pool->y[index] = pool->y[last];
+    pool->prev_x[index] = pool->prev_x[last];
+    pool->direction[index] = pool->direction[last];
+    pool->swept_x[index] = pool->swept_x[last];
+    pool->swept_width[index] = pool->swept_width[last];
+    pool->owner[index] = pool->owner[last];
+}
+
+bool BulletPoolIsFlagged(const BulletPool *pool, int index)
+{
+    int group = index / BULLET_REMOVAL_GROUP;
+    return pool->removals[group] & 1 << index % BULLET_REMOVAL_GROUP;
+}
+
+// Every kernel handles whole groups of bullets up to end, including padding
+// past count, and writes one removal byte per group
+
+static void BulletIntegrateScalar(BulletPool *pool, int end, float distance,
+                                  float min_x, float max_x)
+{
+    for (int group = 0; group < end; group += BULLET_REMOVAL_GROUP) {
+        int bits = 0;
+        for (int lane = 0; lane < BULLET_REMOVAL_GROUP; lane++) {
+            int i = group + lane;
+            float prev_x = pool->x[i];
+            float x = prev_x + distance * pool->direction[i];
+            pool->prev_x[i] = prev_x;
+            pool->x[i] = x;
+            pool->swept_x[i] = fminf(x, prev_x);
+            pool->swept_width[i] = fabsf(x - prev_x);
+            bits |= ((x > max_x) | (x < min_x)) << lane;
+        }
+        pool->removals[group / BULLET_REMOVAL_GROUP] = bits;
+    }
+}
+
+#ifdef BULLET_KERNEL_X86
+__attribute__((target("sse2"))) static void
+BulletIntegrateSse2(BulletPool *pool, int end, float distance, float min_x,
+                    float max_x)
+{
+    const __m128 distances = _mm_set1_ps(distance);
+    const __m128 min_xs = _mm_set1_ps(min_x);
+    const __m128 max_xs = _mm_set1_ps(max_x);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for (int group = 0; group < end; group += BULLET_REMOVAL_GROUP) {
+        int bits = 0;
+        for (int lane = 0; lane < BULLET_REMOVAL_GROUP; lane += 4) {
+            int i = group + lane;
+            __m128 prev_x = _mm_load_ps(pool->x + i);
+            __m128 x = _mm_add_ps(
+                prev_x,
+                _mm_mul_ps(distances, _mm_load_ps(pool->direction + i)));
+            _mm_store_ps(pool->prev_x + i, prev_x);
+            _mm_store_ps(pool->x + i, x);
+            _mm_store_ps(pool->swept_x + i, _mm_min_ps(x, prev_x));
+            _mm_store_ps(pool->swept_width + i,
+                         _mm_andnot_ps(sign, _mm_sub_ps(x, prev_x)));
+            __m128 outside = _mm_or_ps(_mm_cmpgt_ps(x, max_xs),
+                                       _mm_cmplt_ps(x, min_xs));
+            bits |= _mm_movemask_ps(outside) << lane;
+        }
+        pool->removals[group / BULLET_REMOVAL_GROUP] = bits;
+    }
+}
+
+__attribute__((target("avx2"))) static void
+BulletIntegrateAvx2(BulletPool *pool, int end, float distance, float min_x,
+                    float max_x)
+{
+    const __m256 distances = _mm256_set1_ps(distance);
+    const __m256 min_xs = _mm256_set1_ps(min_x);
+    const __m256 max_xs = _mm256_set1_ps(max_x);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    for (int i = 0; i < end; i += BULLET_REMOVAL_GROUP) {
+        __m256 prev_x = _mm256_load_ps(pool->x + i);
+        __m256 x = _mm256_add_ps(
+            prev_x,
+            _mm256_mul_ps(distances, _mm256_load_ps(pool->direction + i)));
+        _mm256_store_ps(pool->prev_x + i, prev_x);
+        _mm256_store_ps(pool->x + i, x);
+        _mm256_store_ps(pool->swept_x + i, _mm256_min_ps(x, prev_x));
+        _mm256_store_ps(pool->swept_width + i,
+                        _mm256_andnot_ps(sign, _mm256_sub_ps(x, prev_x)));
+        __m256 outside = _mm256_or_ps(_mm256_cmp_ps(x, max_xs, _CMP_GT_OQ),
+                                      _mm256_cmp_ps(x, min_xs, _CMP_LT_OQ));
+        pool->removals[i / BULLET_REMOVAL_GROUP] = _mm256_movemask_ps(outside);
+    }
+}
+#endif
+
+void BulletPoolIntegrate(BulletPool *pool, float distance, float min_x,
+                         float max_x)
+{
+    int end = BulletGetGroupCount(pool->count) * BULLET_REMOVAL_GROUP;
+    switch (pool->kernel) {
+#ifdef BULLET_KERNEL_X86
+    case BULLET_KERNEL_AVX2:
+        BulletIntegrateAvx2(pool, end, distance, min_x, max_x);
+        break;
+    case BULLET_KERNEL_SSE2:
+        BulletIntegrateSse2(pool, end, distance, min_x, max_x);
+        break;
+#endif
+    default:
+        BulletIntegrateScalar(pool, end, distance, min_x, max_x);
+        break;
+    }
+    // Padding past count may hold anything, never flag it
+    if (pool->count % BULLET_REMOVAL_GROUP) {
+        pool->removals[pool->count / BULLET_REMOVAL_GROUP] &=
+            (1 << pool->count % BULLET_REMOVAL_GROUP) - 1;
+    }
+}
+
+bool BulletKernelSupported(BulletKernel kernel)
+{
+    switch (kernel) {
+    case BULLET_KERNEL_SCALAR:
+        return true;
+#ifdef BULLET_KERNEL_X86
+    case BULLET_KERNEL_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case BULLET_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+BulletKernel BulletKernelDetect(void)
+{
+    for (int kernel = BULLET_KERNEL_COUNT - 1; kernel > 0; kernel--) {
+        if (BulletKernelSupported(kernel)) {
+            return kernel;
+        }
+    }
+    return BULLET_KERNEL_SCALAR;
+}
+
+const char *BulletKernelGetName(BulletKernel kernel)
+{
+    static const char *const names[BULLET_KERNEL_COUNT] = {
+        [BULLET_KERNEL_SCALAR] = "scalar",
+        [BULLET_KERNEL_SSE2] = "sse2",
+        [BULLET_KERNEL_AVX2] = "avx2",
+    };
+    return names[kernel];
+}
@@ -0,0 +1,63 @@
+#ifndef SPACEWAR_BULLETS_H
+#define SPACEWAR_BULLETS_H
+
+// Storage for every bullet in a match and the per-tick pass that moves them.
+// The pass has scalar, SSE2 and AVX2 versions that give bit-identical
+// results, the best one the CPU supports is picked at runtime.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Bullets per byte of BulletPool.removals, also the step of every kernel
+#define BULLET_REMOVAL_GROUP 8
+
+typedef enum {
+    BULLET_KERNEL_SCALAR,
+    BULLET_KERNEL_SSE2,
+    BULLET_KERNEL_AVX2,
+    BULLET_KERNEL_COUNT,
+} BulletKernel;
+
+// Bullets as a struct of arrays. Live bullets are packed into [0, count):
+// spawning takes the first free slot at count and removing moves the last
+// live bullet into the hole, so every pass only touches live bullets. Each
+// array is cache line aligned and padded to a whole number of cache lines,
+// so vector code may run up to a whole group of bullets past count.
+typedef struct {
+    int capacity;
+    int count;
+    float *x;
+    float *y;
+    // x at the start of the last tick, bullets only move horizontally
+    float *prev_x;
+    // 1 flying right, -1 flying left
+    float *direction;
+    // Index into SimState.ships
+    uint8_t *owner;
+    // Horizontal span each bullet swept over during the last tick
+    float *swept_x;
+    float *swept_width;
+    // One bit per bullet, set by BulletPoolIntegrate if it left the arena
+    uint8_t *removals;
+    BulletKernel kernel;
+    void *storage;
+} BulletPool;
+
+bool BulletPoolInit(BulletPool *pool, int capacity);
+void BulletPoolDeinit(BulletPool *pool);
+// Copies the live bullets, destination must have room for them
+void BulletPoolCopy(BulletPool *destination, const BulletPool *source);
+// Moves the last bullet into index, leaving the removal bits as they are
+void BulletPoolSwapRemove(BulletPool *pool, int index);
+// Moves every bullet by distance in its direction, fills in the swept spans
+// and flags the bullets now left of min_x or right of max_x for removal
+void BulletPoolIntegrate(BulletPool *pool, float distance, float min_x,
+                         float max_x);
+bool BulletPoolIsFlagged(const BulletPool *pool, int index);
+
+// Best kernel this CPU runs, chosen for every new pool
+BulletKernel BulletKernelDetect(void);
+bool BulletKernelSupported(BulletKernel kernel);
+const char *BulletKernelGetName(BulletKernel kernel);
+
+#endif /* ifndef SPACEWAR_BULLETS_H */
@@ -0,0 +1,71 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "spacewar_file.h"
+
+bool MappedFileOpen(MappedFile *file, const char *path)
+{
+    *file = (MappedFile){0};
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == handle) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(handle, &size) && size.QuadPart > 0) {
+        mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    CloseHandle(handle);
+    if (NULL == mapping) {
+        return false;
+    }
+    file->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (NULL == file->data) {
+        CloseHandle(mapping);
+        return false;
+    }
+    file->size = size.QuadPart;
+    file->mapping = mapping;
+#else
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0) {
+        return false;
+    }
+    struct stat stat_buffer;
+    void *data = MAP_FAILED;
+    if (0 == fstat(descriptor, &stat_buffer) && stat_buffer.st_size > 0) {
+        data = mmap(NULL, stat_buffer.st_size, PROT_READ, MAP_PRIVATE,
+                    descriptor, 0);
+    }
+    close(descriptor);
+    if (MAP_FAILED == data) {
+        return false;
+    }
+    file->data = data;
+    file->size = stat_buffer.st_size;
+#endif
+    return true;
+}
+
+void MappedFileClose(MappedFile *file)
+{
+    if (NULL == file->data) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle(file->mapping);
+#else
+    munmap((void *)file->data, file->size);
+#endif
+    *file = (MappedFile){0};
+}
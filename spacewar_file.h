@@ -0,0 +1,22 @@
+#ifndef SPACEWAR_FILE_H
+#define SPACEWAR_FILE_H
+
+// Read-only memory mapped files, for replays and the asset archive. Mapping
+// a file costs a couple of system calls however big it is, and pages are
+// only read from disk when first touched.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    // Mapping object on Windows
+    void *mapping;
+} MappedFile;
+
+// Fails for missing and empty files
+bool MappedFileOpen(MappedFile *file, const char *path);
+void MappedFileClose(MappedFile *file);
+
+#endif /* ifndef SPACEWAR_FILE_H */
@@ -0,0 +1,81 @@
+#include <stdlib.h>
+
+#include "spacewar_frame_stats.h"
+
+static const char *const FRAME_PHASE_NAMES[FRAME_PHASE_COUNT] = {
+    "input", "update", "draw", "blit", "present"};
+
+const char *FramePhaseGetName(FramePhase phase)
+{
+    return FRAME_PHASE_NAMES[phase];
+}
+
+void FrameStatsClear(FrameStats *stats)
+{
+    stats->head = 0;
+    stats->count = 0;
+}
+
+void FrameStatsAdd(FrameStats *stats, const FrameSample *sample)
+{
+    stats->samples[stats->head] = *sample;
+    stats->head = (stats->head + 1) % FRAME_STATS_CAPACITY;
+    if (stats->count < FRAME_STATS_CAPACITY) {
+        stats->count++;
+    }
+}
+
+const FrameSample *FrameStatsGet(const FrameStats *stats, int i)
+{
+    int index = stats->head - 1 - i;
+    if (index < 0) {
+        index += FRAME_STATS_CAPACITY;
+    }
+    return &stats->samples[index];
+}
+
+static int CompareFloats(const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank percentile of sorted times
+static float GetPercentile(const float *sorted, int count, int percent)
+{
+    int rank = (count * percent + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+FrameSummary FrameStatsSummarize(const FrameStats *stats, float window)
+{
+    FrameSummary summary = {0};
+    float times[FRAME_STATS_CAPACITY];
+    float total = 0.0f;
+    for (int i = 0; i < stats->count; i++) {
+        const FrameSample *sample = FrameStatsGet(stats, i);
+        total += sample->frame;
+        if (total > window && i > 0) {
+            break;
+        }
+        times[i] = sample->frame;
+        for (int phase = 0; phase < FRAME_PHASE_COUNT; phase++) {
+            summary.phase_means[phase] += sample->phases[phase];
+        }
+        summary.frame_count++;
+    }
+    if (0 == summary.frame_count) {
+        return summary;
+    }
+
+    for (int phase = 0; phase < FRAME_PHASE_COUNT; phase++) {
+        summary.phase_means[phase] /= summary.frame_count;
+    }
+    qsort(times, summary.frame_count, sizeof(times[0]), &CompareFloats);
+    summary.p50 = GetPercentile(times, summary.frame_count, 50);
+    summary.p95 = GetPercentile(times, summary.frame_count, 95);
+    summary.p99 = GetPercentile(times, summary.frame_count, 99);
+    summary.max = times[summary.frame_count - 1];
+    return summary;
+}
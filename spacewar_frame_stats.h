@@ -0,0 +1,53 @@
+#ifndef SPACEWAR_FRAME_STATS_H
+#define SPACEWAR_FRAME_STATS_H
+
+// Rolling frame times, split into the phases of a frame, summarized as
+// percentiles over the last few seconds. Kept apart from Raylib so headless
+// tools can time their loops the same way the game does.
+
+#define FRAME_STATS_CAPACITY 2048
+
+typedef enum {
+    FRAME_PHASE_INPUT,
+    FRAME_PHASE_UPDATE,
+    // Drawing the game into the screen's render texture
+    FRAME_PHASE_DRAW,
+    // Scaling the screen up to the window
+    FRAME_PHASE_BLIT,
+    // Swapping buffers, waiting for vsync and polling window events
+    FRAME_PHASE_PRESENT,
+    FRAME_PHASE_COUNT,
+} FramePhase;
+
+// Times in seconds
+typedef struct {
+    float frame;
+    float phases[FRAME_PHASE_COUNT];
+} FrameSample;
+
+typedef struct {
+    FrameSample samples[FRAME_STATS_CAPACITY];
+    // Where the next sample goes
+    int head;
+    int count;
+} FrameStats;
+
+typedef struct {
+    int frame_count;
+    float p50;
+    float p95;
+    float p99;
+    float max;
+    float phase_means[FRAME_PHASE_COUNT];
+} FrameSummary;
+
+const char *FramePhaseGetName(FramePhase phase);
+
+void FrameStatsClear(FrameStats *stats);
+void FrameStatsAdd(FrameStats *stats, const FrameSample *sample);
+// The i-th newest sample, 0 being the last one added
+const FrameSample *FrameStatsGet(const FrameStats *stats, int i);
+// Summarizes the newest frames that add up to at most window seconds
+FrameSummary FrameStatsSummarize(const FrameStats *stats, float window);
+
+#endif /* ifndef SPACEWAR_FRAME_STATS_H */
@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "spacewar_grid.h"
+
+static int SpatialGridGetColumn(const SpatialGrid *grid, float x)
+{
+    int column = x / grid->cell_size;
+    return column < 0 ? 0
+                      : (column >= grid->columns ? grid->columns - 1 : column);
+}
+
+static int SpatialGridGetRow(const SpatialGrid *grid, float y)
+{
+    int row = y / grid->cell_size;
+    return row < 0 ? 0 : (row >= grid->rows ? grid->rows - 1 : row);
+}
+
+bool SpatialGridInit(SpatialGrid *grid, float width, float height,
+                     float cell_size)
+{
+    *grid = (SpatialGrid){.cell_size = cell_size,
+                          .columns = (width + cell_size - 1) / cell_size,
+                          .rows = (height + cell_size - 1) / cell_size};
+    grid->cell_starts =
+        calloc(grid->columns * grid->rows + 1, sizeof(*grid->cell_starts));
+    return NULL != grid->cell_starts;
+}
+
+void SpatialGridDeinit(SpatialGrid *grid)
+{
+    free(grid->cell_starts);
+    free(grid->entries);
+    free(grid->added);
+    free(grid->added_cells);
+    *grid = (SpatialGrid){0};
+}
+
+void SpatialGridClear(SpatialGrid *grid)
+{
+    grid->count = 0;
+    grid->max_width = 0.0f;
+    grid->max_height = 0.0f;
+}
+
+bool SpatialGridReserve(SpatialGrid *grid, int count)
+{
+    if (count <= grid->capacity) {
+        return true;
+    }
+    int capacity = grid->capacity ? grid->capacity : 64;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    GridEntry *entries = realloc(grid->entries, capacity * sizeof(*entries));
+    if (NULL == entries) {
+        return false;
+    }
+    grid->entries = entries;
+    GridEntry *added = realloc(grid->added, capacity * sizeof(*added));
+    if (NULL == added) {
+        return false;
+    }
+    grid->added = added;
+    int *added_cells =
+        realloc(grid->added_cells, capacity * sizeof(*added_cells));
+    if (NULL == added_cells) {
+        return false;
+    }
+    grid->added_cells = added_cells;
+    grid->capacity = capacity;
+    return true;
+}
+
+void SpatialGridAdd(SpatialGrid *grid, float x, float y, float width,
+                    float height, uint32_t index)
+{
+    int i = grid->count++;
+    grid->added[i] = (GridEntry){.index = index};
+    grid->added_cells[i] = SpatialGridGetRow(grid, y) * grid->columns +
+                           SpatialGridGetColumn(grid, x);
+    grid->max_width = width > grid->max_width ? width : grid->max_width;
+    grid->max_height = height > grid->max_height ? height : grid->max_height;
+}
+
+void SpatialGridBuild(SpatialGrid *grid)
+{
+    int cell_count = grid->columns * grid->rows;
+    int *starts = grid->cell_starts;
+    memset(starts, 0, (cell_count + 1) * sizeof(*starts));
+    for (int i = 0; i < grid->count; i++) {
+        starts[grid->added_cells[i] + 1]++;
+    }
+    for (int cell = 0; cell < cell_count; cell++) {
+        starts[cell + 1] += starts[cell];
+    }
+    // starts[cell] is used as the fill position and ends up at the start of
+    // the next cell, shift them back afterwards
+    for (int i = 0; i < grid->count; i++) {
+        grid->entries[starts[grid->added_cells[i]]++] = grid->added[i];
+    }
+    memmove(starts + 1, starts, cell_count * sizeof(*starts));
+    starts[0] = 0;
+}
+
+SpatialGridQuery SpatialGridQueryCreate(const SpatialGrid *grid, float x,
+                                        float y, float width, float height)
+{
+    int min_column = SpatialGridGetColumn(grid, x - grid->max_width);
+    int min_row = SpatialGridGetRow(grid, y - grid->max_height);
+    return (SpatialGridQuery){
+        .grid = grid,
+        .min_column = min_column,
+        .max_column = SpatialGridGetColumn(grid, x + width),
+        .max_row = SpatialGridGetRow(grid, y + height),
+        .column = min_column - 1,
+        .row = min_row};
+}
+
+bool SpatialGridQueryNext(SpatialGridQuery *query, GridEntry *entry)
+{
+    const SpatialGrid *grid = query->grid;
+    while (query->next == query->end) {
+        if (++query->column > query->max_column) {
+            query->column = query->min_column;
+            if (++query->row > query->max_row) {
+                return false;
+            }
+        }
+        int cell = query->row * grid->columns + query->column;
+        query->next = grid->cell_starts[cell];
+        query->end = grid->cell_starts[cell + 1];
+    }
+    *entry = grid->entries[query->next++];
+    return true;
+}
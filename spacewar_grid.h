@@ -0,0 +1,64 @@
+#ifndef SPACEWAR_GRID_H
+#define SPACEWAR_GRID_H
+
+// Uniform grid broad phase over the arena. The grid is rebuilt from scratch
+// every tick: entities are added, sorted into cells in one counting pass and
+// then looked up by area. Each entity is kept in the single cell of its top
+// left corner and queries reach back by the largest entity added, so nothing
+// is ever returned twice. Entities outside the arena go into the border
+// cells.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Only bullets go in the grid, ships query it
+typedef struct {
+    uint32_t index;
+} GridEntry;
+
+typedef struct {
+    float cell_size;
+    int columns;
+    int rows;
+    // Entries of cell c are entries[cell_starts[c]] up to cell_starts[c + 1]
+    int *cell_starts;
+    GridEntry *entries;
+    // Added since the last SpatialGridClear, in the order they came
+    GridEntry *added;
+    int *added_cells;
+    int count;
+    int capacity;
+    float max_width;
+    float max_height;
+} SpatialGrid;
+
+// Walks the entries of every cell an area may have entities in
+typedef struct {
+    const SpatialGrid *grid;
+    int min_column;
+    int max_column;
+    int max_row;
+    int column;
+    int row;
+    int next;
+    int end;
+} SpatialGridQuery;
+
+bool SpatialGridInit(SpatialGrid *grid, float width, float height,
+                     float cell_size);
+void SpatialGridDeinit(SpatialGrid *grid);
+void SpatialGridClear(SpatialGrid *grid);
+// Makes room for count entities in total, returns false if out of memory
+bool SpatialGridReserve(SpatialGrid *grid, int count);
+// The grid must have room, see SpatialGridReserve
+void SpatialGridAdd(SpatialGrid *grid, float x, float y, float width,
+                    float height, uint32_t index);
+// Sorts everything added into cells, call before querying
+void SpatialGridBuild(SpatialGrid *grid);
+
+// Candidates that may overlap the area, the caller tests them exactly
+SpatialGridQuery SpatialGridQueryCreate(const SpatialGrid *grid, float x,
+                                        float y, float width, float height);
+bool SpatialGridQueryNext(SpatialGridQuery *query, GridEntry *entry);
+
+#endif /* ifndef SPACEWAR_GRID_H */
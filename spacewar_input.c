@@ -0,0 +1,9 @@
+#include "spacewar_input.h"
+
+void InputSourcesSample(InputSource *const sources[SIM_MAX_SHIPS],
+                        const SimState *sim, InputMask inputs[SIM_MAX_SHIPS])
+{
+    for (int i = 0; i < sim->setup.ship_count; i++) {
+        inputs[i] = sources[i]->Sample(sources[i], sim, i);
+    }
+}
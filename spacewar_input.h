@@ -0,0 +1,20 @@
+#ifndef SPACEWAR_INPUT_H
+#define SPACEWAR_INPUT_H
+
+// Where per-tick input comes from. The keyboard, bots, replay files and
+// network peers all implement InputSource, so the simulation only ever sees
+// one InputMask per player per tick.
+
+#include "spacewar_sim.h"
+
+typedef struct InputSource {
+    // Returns player's input for the tick sim is about to run
+    InputMask (*Sample)(struct InputSource *source, const SimState *sim,
+                        int player);
+} InputSource;
+
+// Samples every player's source exactly once for the next tick
+void InputSourcesSample(InputSource *const sources[SIM_MAX_SHIPS],
+                        const SimState *sim, InputMask inputs[SIM_MAX_SHIPS]);
+
+#endif /* ifndef SPACEWAR_INPUT_H */
@@ -0,0 +1,480 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "spacewar_net.h"
+
+enum {
+    NET_PACKET_SYNC = 1,
+    NET_PACKET_INPUT = 2,
+};
+
+#define SYNC_PACKET_SIZE 12
+#define INPUT_PACKET_HEADER_SIZE 11
+
+static void PutU32(unsigned char *bytes, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+static uint32_t GetU32(const unsigned char *bytes)
+{
+    return bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 |
+           (uint32_t)bytes[3] << 24;
+}
+
+static uint32_t NextRandom(uint32_t *state)
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static void UdpTransportSend(Transport *transport, const void *data, int size)
+{
+    UdpTransport *udp = (UdpTransport *)transport;
+    if (0 == udp->peer_address_size) {
+        // Hosting and nobody has connected yet
+        return;
+    }
+    sendto(udp->socket, data, size, 0,
+           (const struct sockaddr *)udp->peer_address,
+           udp->peer_address_size);
+}
+
+static int UdpTransportReceive(Transport *transport, void *buffer,
+                               int capacity)
+{
+    UdpTransport *udp = (UdpTransport *)transport;
+    struct sockaddr_storage from;
+    socklen_t from_size = sizeof(from);
+    for (;;) {
+        int size = recvfrom(udp->socket, buffer, capacity, 0,
+                            (struct sockaddr *)&from, &from_size);
+        if (size <= 0) {
+            return 0;
+        }
+        if (0 == udp->peer_address_size) {
+            memcpy(udp->peer_address, &from, from_size);
+            udp->peer_address_size = from_size;
+        }
+        // Drop anything that is not from the peer
+        if ((int)from_size == udp->peer_address_size &&
+            0 == memcmp(&from, udp->peer_address, from_size)) {
+            return size;
+        }
+        from_size = sizeof(from);
+    }
+}
+
+// Undoes the WSAStartup of UdpTransportOpen on Windows
+static void UdpTransportCleanup(void)
+{
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+bool UdpTransportOpen(UdpTransport *udp, int local_port, const char *peer_host,
+                      int peer_port)
+{
+    *udp = (UdpTransport){.transport = {.Send = &UdpTransportSend,
+                                        .Receive = &UdpTransportReceive}};
+#ifdef _WIN32
+    WSADATA wsa_data;
+    if (0 != WSAStartup(MAKEWORD(2, 2), &wsa_data)) {
+        return false;
+    }
+#endif
+
+    if (NULL != peer_host) {
+        struct addrinfo hints = {.ai_family = AF_INET,
+                                 .ai_socktype = SOCK_DGRAM};
+        struct addrinfo *peer = NULL;
+        char port[8];
+        snprintf(port, sizeof(port), "%d", peer_port);
+        if (0 != getaddrinfo(peer_host, port, &hints, &peer)) {
+            UdpTransportCleanup();
+            return false;
+        }
+        memcpy(udp->peer_address, peer->ai_addr, peer->ai_addrlen);
+        udp->peer_address_size = peer->ai_addrlen;
+        freeaddrinfo(peer);
+    }
+
+    udp->socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (udp->socket < 0) {
+        UdpTransportCleanup();
+        return false;
+    }
+    struct sockaddr_in local = {.sin_family = AF_INET,
+                                .sin_port = htons(local_port),
+                                .sin_addr.s_addr = htonl(INADDR_ANY)};
+    if (0 != bind(udp->socket, (struct sockaddr *)&local, sizeof(local))) {
+        UdpTransportClose(udp);
+        return false;
+    }
+#ifdef _WIN32
+    u_long non_blocking = 1;
+    ioctlsocket(udp->socket, FIONBIO, &non_blocking);
+#else
+    fcntl(udp->socket, F_SETFL, fcntl(udp->socket, F_GETFL) | O_NONBLOCK);
+#endif
+    return true;
+}
+
+void UdpTransportClose(UdpTransport *udp)
+{
+#ifdef _WIN32
+    closesocket(udp->socket);
+#else
+    close(udp->socket);
+#endif
+    UdpTransportCleanup();
+    udp->socket = -1;
+}
+
+static void LoopbackTransportSend(Transport *transport, const void *data,
+                                  int size)
+{
+    LoopbackTransport *end = (LoopbackTransport *)transport;
+    LoopbackNetwork *network = end->network;
+    int destination = 1 - end->side;
+
+    float roll = (NextRandom(&network->rng) >> 8) / (float)(1 << 24);
+    if (roll < network->loss ||
+        network->queue_counts[destination] == LOOPBACK_QUEUE_CAPACITY ||
+        size > NET_MAX_PACKET_SIZE) {
+        return;
+    }
+
+    double jitter = network->jitter * (NextRandom(&network->rng) >> 8) /
+                    (double)(1 << 24);
+    LoopbackPacket *packet =
+        &network->queues[destination][network->queue_counts[destination]++];
+    packet->size = size;
+    packet->deliver_time = network->time + network->latency + jitter;
+    memcpy(packet->data, data, size);
+}
+
+static int LoopbackTransportReceive(Transport *transport, void *buffer,
+                                    int capacity)
+{
+    LoopbackTransport *end = (LoopbackTransport *)transport;
+    LoopbackNetwork *network = end->network;
+    LoopbackPacket *queue = network->queues[end->side];
+    int *count = &network->queue_counts[end->side];
+
+    // Jitter can reorder packets, so deliver the earliest due one
+    int earliest = -1;
+    for (int i = 0; i < *count; i++) {
+        if (queue[i].deliver_time <= network->time &&
+            (earliest < 0 ||
+             queue[i].deliver_time < queue[earliest].deliver_time)) {
+            earliest = i;
+        }
+    }
+    if (earliest < 0) {
+        return 0;
+    }
+
+    int size = queue[earliest].size < capacity ? queue[earliest].size
+                                               : capacity;
+    memcpy(buffer, queue[earliest].data, size);
+    queue[earliest] = queue[--*count];
+    return size;
+}
+
+void LoopbackNetworkInit(LoopbackNetwork *network, double latency,
+                         double jitter, float loss, uint32_t seed)
+{
+    *network = (LoopbackNetwork){.latency = latency,
+                                 .jitter = jitter,
+                                 .loss = loss,
+                                 .rng = seed ? seed : 1};
+    for (int side = 0; side < 2; side++) {
+        network->ends[side] = (LoopbackTransport){
+            .transport = {.Send = &LoopbackTransportSend,
+                          .Receive = &LoopbackTransportReceive},
+            .network = network,
+            .side = side};
+    }
+}
+
+void LoopbackNetworkAdvance(LoopbackNetwork *network, double seconds)
+{
+    network->time += seconds;
+}
+
+bool RollbackSessionInit(RollbackSession *session, Transport *transport,
+                         int local_player, int tick_rate, uint32_t seed,
+                         int bullet_capacity)
+{
+    *session = (RollbackSession){.transport = transport,
+                                 .local_player = local_player,
+                                 .tick_rate = tick_rate,
+                                 .max_rollback_ticks =
+                                     ROLLBACK_DEFAULT_MAX_TICKS};
+    for (int i = 0; i < ROLLBACK_MAX_TICKS + 1; i++) {
+        if (!SimInit(&session->snapshots[i], bullet_capacity)) {
+            RollbackSessionDeinit(session);
+            return false;
+        }
+    }
+    RollbackSessionRestart(session, seed);
+    return true;
+}
+
+void RollbackSessionDeinit(RollbackSession *session)
+{
+    for (int i = 0; i < ROLLBACK_MAX_TICKS + 1; i++) {
+        SimDeinit(&session->snapshots[i]);
+    }
+}
+
+void RollbackSessionRestart(RollbackSession *session, uint32_t seed)
+{
+    session->status = ROLLBACK_SYNCING;
+    session->match++;
+    session->seed = seed;
+    memset(session->local_inputs, 0, sizeof(session->local_inputs));
+    memset(session->remote_inputs, 0, sizeof(session->remote_inputs));
+    session->remote_tick_count = 0;
+    session->peer_ack = 0;
+    session->rollback_tick = UINT32_MAX;
+    session->recorded_tick = 0;
+    session->last_rollback_ticks = 0;
+}
+
+static void RollbackSessionSendSync(RollbackSession *session)
+{
+    unsigned char packet[SYNC_PACKET_SIZE];
+    packet[0] = NET_PACKET_SYNC;
+    packet[1] = session->match;
+    PutU32(packet + 2, SimGetConstantsHash());
+    packet[6] = session->tick_rate & 0xFF;
+    packet[7] = session->tick_rate >> 8;
+    PutU32(packet + 8, session->seed);
+    session->transport->Send(session->transport, packet, sizeof(packet));
+}
+
+static void RollbackSessionHandleSync(RollbackSession *session,
+                                      const unsigned char *packet)
+{
+    int tick_rate = packet[6] | packet[7] << 8;
+    if (SimGetConstantsHash() != GetU32(packet + 2) ||
+        session->tick_rate != tick_rate) {
+        session->status = ROLLBACK_INCOMPATIBLE;
+        return;
+    }
+
+    if (ROLLBACK_RUNNING == session->status) {
+        // Our sync got lost, the peer is still waiting for it
+        RollbackSessionSendSync(session);
+    } else if (ROLLBACK_SYNCING == session->status) {
+        if (0 != session->local_player) {
+            session->seed = GetU32(packet + 8);
+        }
+        session->status = ROLLBACK_RUNNING;
+    }
+}
+
+static void RollbackSessionHandleInput(RollbackSession *session,
+                                       const SimState *sim,
+                                       const unsigned char *packet, int size)
+{
+    uint32_t ack = GetU32(packet + 2);
+    uint32_t start = GetU32(packet + 6);
+    int count = packet[10];
+    if (size < INPUT_PACKET_HEADER_SIZE + count) {
+        return;
+    }
+    if (ack > session->peer_ack && ack <= sim->tick) {
+        session->peer_ack = ack;
+    }
+
+    for (int i = 0; i < count; i++) {
+        uint32_t tick = start + i;
+        if (tick < session->remote_tick_count) {
+            // Resent input we already have
+            continue;
+        }
+        if (tick > session->remote_tick_count ||
+            tick >= sim->tick + ROLLBACK_INPUT_BUFFER) {
+            break;
+        }
+
+        InputMask input = packet[INPUT_PACKET_HEADER_SIZE + i];
+        uint32_t slot = tick % ROLLBACK_INPUT_BUFFER;
+        session->remote_inputs[slot] = input;
+        if (tick < sim->tick && session->used_remote_inputs[slot] != input &&
+            tick < session->rollback_tick) {
+            session->rollback_tick = tick;
+        }
+        session->remote_tick_count++;
+    }
+}
+
+bool RollbackSessionPoll(RollbackSession *session, const SimState *sim)
+{
+    unsigned char packet[NET_MAX_PACKET_SIZE];
+    int size;
+    while (0 < (size = session->transport->Receive(session->transport, packet,
+                                                   sizeof(packet)))) {
+        if (size < 2 || packet[1] != session->match) {
+            continue;
+        }
+        if (NET_PACKET_SYNC == packet[0] && size >= SYNC_PACKET_SIZE) {
+            RollbackSessionHandleSync(session, packet);
+        } else if (NET_PACKET_INPUT == packet[0] &&
+                   size >= INPUT_PACKET_HEADER_SIZE) {
+            RollbackSessionHandleInput(session, sim, packet, size);
+        }
+    }
+
+    if (ROLLBACK_SYNCING == session->status) {
+        RollbackSessionSendSync(session);
+    }
+    return ROLLBACK_RUNNING == session->status;
+}
+
+// Remote input for tick, predicted as the last known one if not arrived yet
+static InputMask RollbackSessionRemoteInput(const RollbackSession *session,
+                                            uint32_t tick)
+{
+    if (tick < session->remote_tick_count) {
+        return session->remote_inputs[tick % ROLLBACK_INPUT_BUFFER];
+    }
+    if (0 == session->remote_tick_count) {
+        return 0;
+    }
+    uint32_t last = session->remote_tick_count - 1;
+    return session->remote_inputs[last % ROLLBACK_INPUT_BUFFER];
+}
+
+static SimEvents RollbackSessionSimulate(RollbackSession *session,
+                                         SimState *sim, float deltatime)
+{
+    uint32_t slot = sim->tick % ROLLBACK_INPUT_BUFFER;
+    InputMask remote_input = RollbackSessionRemoteInput(session, sim->tick);
+    session->used_remote_inputs[slot] = remote_input;
+
+    InputMask inputs[SIM_MAX_SHIPS] = {0};
+    inputs[session->local_player] = session->local_inputs[slot];
+    inputs[1 - session->local_player] = remote_input;
+
+    SimSaveSnapshot(sim,
+                    &session->snapshots[sim->tick % (ROLLBACK_MAX_TICKS + 1)]);
+    return SimStep(sim, inputs, deltatime);
+}
+
+static void RollbackSessionRollback(RollbackSession *session, SimState *sim,
+                                    float deltatime)
+{
+    if (session->rollback_tick >= sim->tick) {
+        session->rollback_tick = UINT32_MAX;
+        return;
+    }
+
+    uint32_t present = sim->tick;
+    uint32_t slot = session->rollback_tick % (ROLLBACK_MAX_TICKS + 1);
+    SimLoadSnapshot(sim, &session->snapshots[slot]);
+    while (sim->tick < present) {
+        // Sounds of re-simulated ticks have already been played or missed
+        RollbackSessionSimulate(session, sim, deltatime);
+    }
+    session->last_rollback_ticks = present - session->rollback_tick;
+    session->rollback_tick = UINT32_MAX;
+}
+
+static void RollbackSessionRecordConfirmed(RollbackSession *session,
+                                           const SimState *sim)
+{
+    if (NULL == session->replay_writer) {
+        return;
+    }
+    while (session->recorded_tick < session->remote_tick_count &&
+           session->recorded_tick < sim->tick) {
+        uint32_t slot = session->recorded_tick % ROLLBACK_INPUT_BUFFER;
+        InputMask inputs[SIM_MAX_SHIPS] = {0};
+        inputs[session->local_player] = session->local_inputs[slot];
+        inputs[1 - session->local_player] = session->remote_inputs[slot];
+        ReplayWriterAppend(session->replay_writer, inputs);
+        session->recorded_tick++;
+    }
+}
+
+// Sends every local input the peer has not acknowledged yet, so a lost
+// packet is covered by the next one
+static void RollbackSessionSendInputs(RollbackSession *session,
+                                      const SimState *sim)
+{
+    unsigned char packet[NET_MAX_PACKET_SIZE];
+    uint32_t start = session->peer_ack;
+    int count = sim->tick - start;
+
+    packet[0] = NET_PACKET_INPUT;
+    packet[1] = session->match;
+    PutU32(packet + 2, session->remote_tick_count);
+    PutU32(packet + 6, start);
+    packet[10] = count;
+    for (int i = 0; i < count; i++) {
+        uint32_t slot = (start + i) % ROLLBACK_INPUT_BUFFER;
+        packet[INPUT_PACKET_HEADER_SIZE + i] = session->local_inputs[slot];
+    }
+    session->transport->Send(session->transport, packet,
+                             INPUT_PACKET_HEADER_SIZE + count);
+}
+
+bool RollbackSessionStep(RollbackSession *session, SimState *sim,
+                         InputMask local_input, float deltatime,
+                         SimEvents *events)
+{
+    *events = 0;
+    session->last_rollback_ticks = 0;
+    if (!RollbackSessionPoll(session, sim)) {
+        return false;
+    }
+
+    RollbackSessionRollback(session, sim, deltatime);
+
+    uint32_t unconfirmed = sim->tick > session->remote_tick_count
+                               ? sim->tick - session->remote_tick_count
+                               : 0;
+    bool stalled = unconfirmed >= (uint32_t)session->max_rollback_ticks ||
+                   sim->tick - session->peer_ack >= ROLLBACK_INPUT_BUFFER;
+    if (!stalled) {
+        session->local_inputs[sim->tick % ROLLBACK_INPUT_BUFFER] = local_input;
+        *events = RollbackSessionSimulate(session, sim, deltatime);
+        RollbackSessionRecordConfirmed(session, sim);
+    }
+
+    RollbackSessionSendInputs(session, sim);
+    return !stalled;
+}
+
+bool RollbackSessionConfirmed(const RollbackSession *session, uint32_t tick)
+{
+    return tick <= session->remote_tick_count;
+}
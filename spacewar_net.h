@@ -0,0 +1,135 @@
+#ifndef SPACEWAR_NET_H
+#define SPACEWAR_NET_H
+
+// Two player rollback netcode. Each peer simulates ahead with a prediction of
+// the remote input (the last one received) and, when the real input arrives
+// and differs, restores the snapshot of that tick and re-simulates up to the
+// present. Packets go through a Transport, either UDP or an in-process
+// loopback that can add latency, jitter and packet loss.
+
+#include "spacewar_replay.h"
+#include "spacewar_sim.h"
+
+// Largest packet any transport has to carry
+#define NET_MAX_PACKET_SIZE 128
+// Ticks of input kept for resending and rollback, a power of two
+#define ROLLBACK_INPUT_BUFFER 64
+// Most ticks a peer may run ahead of the last confirmed remote input
+#define ROLLBACK_MAX_TICKS 16
+#define ROLLBACK_DEFAULT_MAX_TICKS 8
+
+typedef struct Transport {
+    // Sends a packet to the peer, it may be lost like a UDP datagram
+    void (*Send)(struct Transport *transport, const void *data, int size);
+    // Copies the next arrived packet into buffer and returns its size, or 0
+    // if nothing has arrived
+    int (*Receive)(struct Transport *transport, void *buffer, int capacity);
+} Transport;
+
+typedef struct {
+    Transport transport;
+    intptr_t socket;
+    // Learned from the first packet when hosting
+    unsigned char peer_address[128];
+    int peer_address_size;
+} UdpTransport;
+
+typedef struct {
+    int size;
+    double deliver_time;
+    unsigned char data[NET_MAX_PACKET_SIZE];
+} LoopbackPacket;
+
+#define LOOPBACK_QUEUE_CAPACITY 64
+
+typedef struct LoopbackNetwork LoopbackNetwork;
+
+typedef struct {
+    Transport transport;
+    LoopbackNetwork *network;
+    int side;
+} LoopbackTransport;
+
+// Two connected transports in one process. Time only moves forward through
+// LoopbackNetworkAdvance, so tests run the same every time.
+struct LoopbackNetwork {
+    LoopbackTransport ends[2];
+    // queues[i] holds packets in flight towards ends[i]
+    LoopbackPacket queues[2][LOOPBACK_QUEUE_CAPACITY];
+    int queue_counts[2];
+    double time;
+    double latency;
+    double jitter;
+    float loss;
+    uint32_t rng;
+};
+
+typedef enum {
+    ROLLBACK_SYNCING,
+    ROLLBACK_RUNNING,
+    // The peer runs a different tick rate or different gameplay constants
+    ROLLBACK_INCOMPATIBLE,
+} RollbackStatus;
+
+typedef struct {
+    Transport *transport;
+    int local_player;
+    int tick_rate;
+    int max_rollback_ticks;
+    RollbackStatus status;
+    // Bumped on every rematch, packets of other matches are ignored
+    uint8_t match;
+    // Chosen by player 0 and adopted by player 1 while syncing
+    uint32_t seed;
+
+    InputMask local_inputs[ROLLBACK_INPUT_BUFFER];
+    // Valid for ticks below remote_tick_count
+    InputMask remote_inputs[ROLLBACK_INPUT_BUFFER];
+    // Remote input each simulated tick actually used
+    InputMask used_remote_inputs[ROLLBACK_INPUT_BUFFER];
+    // Remote inputs received so far, without gaps
+    uint32_t remote_tick_count;
+    // Local inputs the peer has received, the rest get resent
+    uint32_t peer_ack;
+    // Earliest tick simulated with a wrong prediction, UINT32_MAX if none
+    uint32_t rollback_tick;
+    // State at the start of each of the last ticks
+    SimSnapshot snapshots[ROLLBACK_MAX_TICKS + 1];
+
+    // Confirmed ticks are appended here if set
+    ReplayWriter *replay_writer;
+    uint32_t recorded_tick;
+
+    // Ticks re-simulated by the last RollbackSessionStep
+    int last_rollback_ticks;
+} RollbackSession;
+
+bool UdpTransportOpen(UdpTransport *udp, int local_port, const char *peer_host,
+                      int peer_port);
+void UdpTransportClose(UdpTransport *udp);
+
+// latency and jitter are in seconds, loss is the chance to drop a packet
+void LoopbackNetworkInit(LoopbackNetwork *network, double latency,
+                         double jitter, float loss, uint32_t seed);
+void LoopbackNetworkAdvance(LoopbackNetwork *network, double seconds);
+
+// Snapshots hold as many bullets as the simulation, bullet_capacity
+bool RollbackSessionInit(RollbackSession *session, Transport *transport,
+                         int local_player, int tick_rate, uint32_t seed,
+                         int bullet_capacity);
+void RollbackSessionDeinit(RollbackSession *session);
+// Starts a rematch, the peers sync again before it runs
+void RollbackSessionRestart(RollbackSession *session, uint32_t seed);
+// Handles arrived packets. Returns true once both peers agree on the match
+// and the caller may reset its simulation with session->seed.
+bool RollbackSessionPoll(RollbackSession *session, const SimState *sim);
+// Runs one tick with the local player's input, rolling back first if a
+// prediction turned out wrong. Returns false without running anything when
+// the peer is too far behind to keep predicting.
+bool RollbackSessionStep(RollbackSession *session, SimState *sim,
+                         InputMask local_input, float deltatime,
+                         SimEvents *events);
+// Whether both players' inputs are known for every tick before tick
+bool RollbackSessionConfirmed(const RollbackSession *session, uint32_t tick);
+
+#endif /* ifndef SPACEWAR_NET_H */
@@ -0,0 +1,152 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdio.h>
+
+#include "spacewar_profile.h"
+
+#ifdef SPACEWAR_PROFILE
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+_Thread_local ProfileThread *profile_thread;
+_Thread_local bool profile_thread_unavailable;
+
+static ProfileThread *profile_threads[PROFILE_MAX_THREADS];
+static atomic_int profile_thread_count;
+
+ProfileThread *ProfileThreadCreate(void)
+{
+    profile_thread_unavailable = true;
+    int id = atomic_fetch_add(&profile_thread_count, 1);
+    if (id >= PROFILE_MAX_THREADS) {
+        return NULL;
+    }
+    ProfileThread *thread = calloc(1, sizeof(*thread));
+    if (NULL == thread) {
+        return NULL;
+    }
+    profile_thread_unavailable = false;
+    thread->id = id;
+    profile_threads[id] = thread;
+    profile_thread = thread;
+    return thread;
+}
+
+uint64_t ProfileGetNanoseconds(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+#endif
+}
+
+// Ticks of ProfileNow per microsecond
+static double ProfileGetTicksPerMicrosecond(void)
+{
+#ifdef PROFILE_HAS_TSC
+    uint64_t start_ns = ProfileGetNanoseconds();
+    uint64_t start_ticks = __rdtsc();
+    uint64_t ns;
+    do {
+        ns = ProfileGetNanoseconds();
+    } while (ns - start_ns < 10000000u);
+    return (double)(__rdtsc() - start_ticks) * 1e3 / (ns - start_ns);
+#else
+    return 1e3;
+#endif
+}
+
+bool ProfileWriteTrace(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (NULL == file) {
+        fprintf(stderr, "Could not write %s\n", path);
+        return false;
+    }
+
+    // Timestamps start at the oldest zone still kept
+    int thread_count = atomic_load(&profile_thread_count);
+    thread_count =
+        thread_count < PROFILE_MAX_THREADS ? thread_count : PROFILE_MAX_THREADS;
+    uint64_t origin = UINT64_MAX;
+    for (int i = 0; i < thread_count; i++) {
+        const ProfileThread *thread = profile_threads[i];
+        if (NULL != thread && thread->count > 0) {
+            uint64_t oldest = thread->count > PROFILE_RING_SIZE
+                                  ? thread->count % PROFILE_RING_SIZE
+                                  : 0;
+            uint64_t start = thread->events[oldest].start;
+            origin = start < origin ? start : origin;
+        }
+    }
+
+    double ticks_per_us = ProfileGetTicksPerMicrosecond();
+    const char *separator = "";
+    fputs("{\"traceEvents\":[\n", file);
+    for (int i = 0; i < thread_count; i++) {
+        const ProfileThread *thread = profile_threads[i];
+        if (NULL == thread) {
+            continue;
+        }
+        uint64_t first = thread->count > PROFILE_RING_SIZE
+                             ? thread->count - PROFILE_RING_SIZE
+                             : 0;
+        for (uint64_t j = first; j < thread->count; j++) {
+            const ProfileEvent *event =
+                &thread->events[j % PROFILE_RING_SIZE];
+            fprintf(file,
+                    "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+                    "\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                    separator, event->name,
+                    (event->start - origin) / ticks_per_us,
+                    (event->end - event->start) / ticks_per_us, thread->id);
+            separator = ",\n";
+        }
+    }
+    fputs("\n]}\n", file);
+    if (0 != fclose(file)) {
+        fprintf(stderr, "Could not write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+void ProfileShutdown(void)
+{
+    int thread_count = atomic_load(&profile_thread_count);
+    for (int i = 0; i < thread_count && i < PROFILE_MAX_THREADS; i++) {
+        free(profile_threads[i]);
+        profile_threads[i] = NULL;
+    }
+    atomic_store(&profile_thread_count, 0);
+    profile_thread = NULL;
+    profile_thread_unavailable = false;
+}
+
+#else
+
+bool ProfileWriteTrace(const char *path)
+{
+    fprintf(stderr, "Built without SPACEWAR_PROFILE, not writing %s\n", path);
+    return false;
+}
+
+void ProfileShutdown(void) {}
+
+#endif /* ifdef SPACEWAR_PROFILE */
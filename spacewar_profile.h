@@ -0,0 +1,94 @@
+#ifndef SPACEWAR_PROFILE_H
+#define SPACEWAR_PROFILE_H
+
+// Scoped profiling zones, compiled in with -DSPACEWAR_PROFILE and to nothing
+// otherwise. Wrap code in PROFILE_BEGIN(Name) and PROFILE_END(Name) in the
+// same block. Each zone costs two timestamps and a store into a ring buffer
+// of the calling thread, and ProfileWriteTrace dumps every thread's buffer
+// as Chrome trace events for chrome://tracing or Perfetto.
+
+#include <stdbool.h>
+
+#ifdef SPACEWAR_PROFILE
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_HAS_TSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define PROFILE_HAS_TSC
+#endif
+
+// Zones kept per thread, older ones are overwritten
+#define PROFILE_RING_SIZE 65536
+#define PROFILE_MAX_THREADS 64
+
+typedef struct {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+} ProfileEvent;
+
+typedef struct {
+    ProfileEvent events[PROFILE_RING_SIZE];
+    // Total zones recorded, the newest is at (count - 1) % PROFILE_RING_SIZE
+    uint64_t count;
+    int id;
+} ProfileThread;
+
+extern _Thread_local ProfileThread *profile_thread;
+// Set once registering the calling thread failed, so it is not tried again
+// for every zone
+extern _Thread_local bool profile_thread_unavailable;
+
+// Registers the calling thread, NULL when out of memory or threads
+ProfileThread *ProfileThreadCreate(void);
+
+uint64_t ProfileGetNanoseconds(void);
+
+// Time stamp counter ticks where there is one, nanoseconds otherwise
+static inline uint64_t ProfileNow(void)
+{
+#ifdef PROFILE_HAS_TSC
+    return __rdtsc();
+#else
+    return ProfileGetNanoseconds();
+#endif
+}
+
+static inline void ProfileRecord(const char *name, uint64_t start)
+{
+    uint64_t end = ProfileNow();
+    ProfileThread *thread = profile_thread;
+    if (NULL == thread) {
+        if (profile_thread_unavailable ||
+            NULL == (thread = ProfileThreadCreate())) {
+            return;
+        }
+    }
+    thread->events[thread->count % PROFILE_RING_SIZE] =
+        (ProfileEvent){name, start, end};
+    thread->count++;
+}
+
+#define PROFILE_BEGIN(zone) uint64_t profile_start_##zone = ProfileNow()
+#define PROFILE_END(zone) ProfileRecord(#zone, profile_start_##zone)
+
+#else
+
+#define PROFILE_BEGIN(zone) ((void)0)
+#define PROFILE_END(zone) ((void)0)
+
+#endif /* ifdef SPACEWAR_PROFILE */
+
+// Writes the zones of every thread as a Chrome trace event JSON file. Other
+// threads should not be recording meanwhile. Fails when profiling is not
+// compiled in.
+bool ProfileWriteTrace(const char *path);
+// Frees every thread's buffer once the other threads that recorded zones
+// have finished
+void ProfileShutdown(void);
+
+#endif /* ifndef SPACEWAR_PROFILE_H */
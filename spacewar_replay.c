@@ -0,0 +1,267 @@
+#include <string.h>
+
+#include "spacewar_replay.h"
+
+static const unsigned char REPLAY_MAGIC[4] = {'S', 'W', 'R', 'P'};
+
+static void WriteU16(unsigned char *bytes, uint32_t value)
+{
+    bytes[0] = value & 0xFF;
+    bytes[1] = (value >> 8) & 0xFF;
+}
+
+static void WriteU32(unsigned char *bytes, uint32_t value)
+{
+    WriteU16(bytes, value & 0xFFFF);
+    WriteU16(bytes + 2, value >> 16);
+}
+
+static uint32_t ReadU16(const unsigned char *bytes)
+{
+    return bytes[0] | (uint32_t)bytes[1] << 8;
+}
+
+static uint32_t ReadU32(const unsigned char *bytes)
+{
+    return ReadU16(bytes) | ReadU16(bytes + 2) << 16;
+}
+
+// Returns the number of bytes written, at most 5
+static int WriteVarint(unsigned char *bytes, uint32_t value)
+{
+    int length = 0;
+    while (value >= 0x80) {
+        bytes[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    bytes[length++] = value;
+    return length;
+}
+
+// Returns false if the stream ends in the middle of the varint
+static bool ReadVarint(const unsigned char **next, const unsigned char *end,
+                       uint32_t *value)
+{
+    *value = 0;
+    for (int shift = 0; *next < end && shift < 32; shift += 7) {
+        unsigned char byte = *(*next)++;
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ReplayHeader ReplayHeaderCreate(const SimState *sim, int tick_rate)
+{
+    return (ReplayHeader){.version = REPLAY_VERSION,
+                          .tick_rate = tick_rate,
+                          .seed = sim->seed,
+                          .constants_hash = SimGetConstantsHash(),
+                          .player_count = sim->setup.ship_count,
+                          .mode = sim->setup.mode};
+}
+
+SimSetup ReplayHeaderGetSetup(const ReplayHeader *header)
+{
+    return (SimSetup){header->player_count, header->mode};
+}
+
+bool ReplayWriterOpen(ReplayWriter *writer, const char *path,
+                      ReplayHeader header)
+{
+    *writer = (ReplayWriter){0};
+    writer->file = fopen(path, "wbx");
+    if (NULL == writer->file) {
+        return false;
+    }
+    setvbuf(writer->file, writer->buffer, _IOFBF, sizeof(writer->buffer));
+    writer->flush_interval = header.tick_rate / 4;
+    writer->player_count = header.player_count;
+
+    unsigned char bytes[REPLAY_HEADER_SIZE] = {0};
+    memcpy(bytes, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    WriteU16(bytes + 4, header.version);
+    WriteU16(bytes + 6, header.tick_rate);
+    WriteU32(bytes + 8, header.seed);
+    WriteU32(bytes + 12, header.constants_hash);
+    bytes[16] = header.player_count;
+    bytes[17] = header.mode;
+    fwrite(bytes, 1, sizeof(bytes), writer->file);
+    fflush(writer->file);
+    return true;
+}
+
+bool ReplayWriterIsOpen(const ReplayWriter *writer)
+{
+    return NULL != writer->file;
+}
+
+static void ReplayWriterPutRecord(ReplayWriter *writer, unsigned char event)
+{
+    unsigned char bytes[6];
+    int length = WriteVarint(bytes, writer->tick - writer->last_record_tick);
+    bytes[length++] = event;
+    fwrite(bytes, 1, length, writer->file);
+    writer->last_record_tick = writer->tick;
+}
+
+void ReplayWriterAppend(ReplayWriter *writer,
+                        const InputMask inputs[SIM_MAX_SHIPS])
+{
+    if (!ReplayWriterIsOpen(writer)) {
+        return;
+    }
+
+    for (int player = 0; player < writer->player_count; player++) {
+        InputMask toggled = inputs[player] ^ writer->last_inputs[player];
+        for (int bit = 0; bit < INPUT_MASK_BITS; bit++) {
+            if (toggled & (1 << bit)) {
+                ReplayWriterPutRecord(writer, player << 3 | bit);
+            }
+        }
+        writer->last_inputs[player] = inputs[player];
+    }
+
+    writer->tick++;
+    if (writer->flush_interval && 0 == writer->tick % writer->flush_interval) {
+        fflush(writer->file);
+    }
+}
+
+void ReplayWriterClose(ReplayWriter *writer)
+{
+    if (!ReplayWriterIsOpen(writer)) {
+        return;
+    }
+    ReplayWriterPutRecord(writer, REPLAY_END_EVENT);
+    fclose(writer->file);
+    writer->file = NULL;
+}
+
+bool ReplayOpen(Replay *replay, const char *path)
+{
+    *replay = (Replay){0};
+    if (!MappedFileOpen(&replay->file, path)) {
+        return false;
+    }
+
+    const unsigned char *bytes = replay->file.data;
+    if (replay->file.size < REPLAY_HEADER_SIZE ||
+        0 != memcmp(bytes, REPLAY_MAGIC, sizeof(REPLAY_MAGIC))) {
+        ReplayClose(replay);
+        return false;
+    }
+    replay->header = (ReplayHeader){.version = ReadU16(bytes + 4),
+                                    .tick_rate = ReadU16(bytes + 6),
+                                    .seed = ReadU32(bytes + 8),
+                                    .constants_hash = ReadU32(bytes + 12),
+                                    .player_count = bytes[16],
+                                    .mode = bytes[17]};
+
+    const ReplayHeader *header = &replay->header;
+    if (REPLAY_VERSION != header->version ||
+        !SimTickRateSupported(header->tick_rate) ||
+        SimGetConstantsHash() != header->constants_hash ||
+        !SimSetupValid(ReplayHeaderGetSetup(header))) {
+        ReplayClose(replay);
+        return false;
+    }
+    return true;
+}
+
+void ReplayClose(Replay *replay)
+{
+    MappedFileClose(&replay->file);
+    *replay = (Replay){0};
+}
+
+// Reads the tick of the next record, leaving its event byte at cursor->next
+static void ReplayCursorPeek(ReplayCursor *cursor)
+{
+    uint32_t delta;
+    if (!ReadVarint(&cursor->next, cursor->end, &delta) ||
+        cursor->next >= cursor->end) {
+        // Truncated stream, e.g. the game crashed while recording
+        cursor->next = cursor->end;
+        return;
+    }
+    cursor->record_tick += delta;
+}
+
+ReplayCursor ReplayCursorCreate(const Replay *replay)
+{
+    const MappedFile *file = &replay->file;
+    ReplayCursor cursor = {.next = file->data + REPLAY_HEADER_SIZE,
+                           .end = file->data + file->size,
+                           .player_count = replay->header.player_count};
+    ReplayCursorPeek(&cursor);
+    return cursor;
+}
+
+bool ReplayCursorNext(ReplayCursor *cursor, InputMask inputs[SIM_MAX_SHIPS])
+{
+    while (!cursor->finished && cursor->next < cursor->end &&
+           cursor->record_tick == cursor->tick) {
+        unsigned char event = *cursor->next++;
+        int player = event >> 3;
+        if (REPLAY_END_EVENT == event || player >= cursor->player_count) {
+            cursor->finished = true;
+            break;
+        }
+        cursor->inputs[player] ^= 1 << (event & 7);
+        ReplayCursorPeek(cursor);
+    }
+    if (cursor->next >= cursor->end) {
+        cursor->finished = true;
+    }
+    if (cursor->finished) {
+        return false;
+    }
+
+    memcpy(inputs, cursor->inputs, sizeof(cursor->inputs));
+    cursor->tick++;
+    return true;
+}
+
+uint32_t ReplayCountTicks(const Replay *replay)
+{
+    ReplayCursor cursor = ReplayCursorCreate(replay);
+    InputMask inputs[SIM_MAX_SHIPS];
+    while (ReplayCursorNext(&cursor, inputs)) {
+    }
+    return cursor.tick;
+}
+
+static InputMask ReplayInputSourceSample(InputSource *source,
+                                         const SimState *sim, int player)
+{
+    ReplayInputSource *replay_source = (ReplayInputSource *)source;
+    ReplayCursor *cursor = &replay_source->cursor;
+    if (sim->tick + 1 < cursor->tick) {
+        // Seeking backwards, decode again from the start
+        *cursor = ReplayCursorCreate(replay_source->replay);
+    }
+
+    InputMask inputs[SIM_MAX_SHIPS] = {0};
+    while (cursor->tick <= sim->tick) {
+        if (!ReplayCursorNext(cursor, inputs)) {
+            return 0;
+        }
+    }
+    return cursor->inputs[player];
+}
+
+ReplayInputSource ReplayInputSourceCreate(const Replay *replay)
+{
+    return (ReplayInputSource){
+        .source = {.Sample = &ReplayInputSourceSample},
+        .replay = replay,
+        .cursor = ReplayCursorCreate(replay)};
+}
+
+bool ReplayInputSourceFinished(const ReplayInputSource *replay_source)
+{
+    return replay_source->cursor.finished;
+}
@@ -0,0 +1,97 @@
+#ifndef SPACEWAR_REPLAY_H
+#define SPACEWAR_REPLAY_H
+
+// Match replays. A replay is a small header followed by the tick of every
+// input change, which is all that is needed to re-run a deterministic match.
+//
+// File layout, little endian:
+//   "SWRP", u16 version, u16 tick rate, u32 seed, u32 constants hash,
+//   u8 player count, u8 SimMode, 2 reserved bytes
+//   then records of varint(ticks since previous record) and one event byte:
+//   (player << 3 | bit) toggles that input bit from then on, and
+//   REPLAY_END_EVENT marks the tick the match ended on.
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "spacewar_file.h"
+#include "spacewar_input.h"
+#include "spacewar_sim.h"
+
+#define REPLAY_VERSION 2
+#define REPLAY_HEADER_SIZE 20
+#define REPLAY_END_EVENT 0xFF
+#define REPLAY_WRITE_BUFFER_SIZE 4096
+
+typedef struct {
+    int version;
+    int tick_rate;
+    uint32_t seed;
+    uint32_t constants_hash;
+    int player_count;
+    SimMode mode;
+} ReplayHeader;
+
+typedef struct {
+    FILE *file;
+    int player_count;
+    InputMask last_inputs[SIM_MAX_SHIPS];
+    uint32_t tick;
+    uint32_t last_record_tick;
+    // Ticks between flushes, so a crash loses at most a fraction of a second
+    uint32_t flush_interval;
+    // Given to stdio, so recording every rematch does not allocate one
+    char buffer[REPLAY_WRITE_BUFFER_SIZE];
+} ReplayWriter;
+
+// A replay file mapped into memory
+typedef struct {
+    ReplayHeader header;
+    MappedFile file;
+} Replay;
+
+// Decodes a replay's input stream one tick at a time
+typedef struct {
+    const unsigned char *next;
+    const unsigned char *end;
+    int player_count;
+    InputMask inputs[SIM_MAX_SHIPS];
+    uint32_t tick;
+    // Tick the next undecoded record applies to
+    uint32_t record_tick;
+    bool finished;
+} ReplayCursor;
+
+typedef struct {
+    InputSource source;
+    const Replay *replay;
+    ReplayCursor cursor;
+} ReplayInputSource;
+
+ReplayHeader ReplayHeaderCreate(const SimState *sim, int tick_rate);
+// Ship count and mode the replay's match was played with
+SimSetup ReplayHeaderGetSetup(const ReplayHeader *header);
+
+// Fails instead of overwriting path when it already exists
+bool ReplayWriterOpen(ReplayWriter *writer, const char *path,
+                      ReplayHeader header);
+bool ReplayWriterIsOpen(const ReplayWriter *writer);
+// Records the inputs of the tick about to run
+void ReplayWriterAppend(ReplayWriter *writer,
+                        const InputMask inputs[SIM_MAX_SHIPS]);
+void ReplayWriterClose(ReplayWriter *writer);
+
+// Maps path and checks its header matches this build of the simulation
+bool ReplayOpen(Replay *replay, const char *path);
+void ReplayClose(Replay *replay);
+
+ReplayCursor ReplayCursorCreate(const Replay *replay);
+// Writes the inputs of the next tick, returns false once the replay is over
+bool ReplayCursorNext(ReplayCursor *cursor, InputMask inputs[SIM_MAX_SHIPS]);
+// Number of ticks in the replay, found by decoding the whole stream
+uint32_t ReplayCountTicks(const Replay *replay);
+
+ReplayInputSource ReplayInputSourceCreate(const Replay *replay);
+bool ReplayInputSourceFinished(const ReplayInputSource *replay_source);
+
+#endif /* ifndef SPACEWAR_REPLAY_H */
@@ -0,0 +1,490 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#define RAYMATH_STATIC_INLINE
+#include "spacewar_profile.h"
+#include "spacewar_sim.h"
+
+static bool CheckRectanglesOverlap(Rectangle rec1, Rectangle rec2)
+{
+    return rec1.x < rec2.x + rec2.width && rec1.x + rec1.width > rec2.x &&
+           rec1.y < rec2.y + rec2.height && rec1.y + rec1.height > rec2.y;
+}
+
+Rectangle ShipGetHitbox(const Ship *ship)
+{
+    return (Rectangle){
+        ship->position.x + SHIP_WIDTH / 2.0f - SHIP_HITBOX_WIDTH / 2.0f,
+        ship->position.y + SHIP_HEIGHT / 2.0f - SHIP_HITBOX_HEIGHT / 2.0f,
+        SHIP_HITBOX_WIDTH, SHIP_HITBOX_HEIGHT};
+}
+
+static bool BulletPoolAddBullet(BulletPool *pool, const Ship *ships,
+                                int owner)
+{
+    if (pool->count == pool->capacity) {
+        return false;
+    }
+
+    int i = pool->count++;
+    const Ship *ship = &ships[owner];
+    pool->x[i] = (ship->facing_right) ? ship->position.x + SHIP_WIDTH
+                                      : ship->position.x - BULLET_WIDTH;
+    pool->y[i] = ship->position.y + SHIP_HEIGHT / 2.0f - BULLET_HEIGHT / 2.0f;
+    pool->prev_x[i] = pool->x[i];
+    pool->swept_x[i] = pool->x[i];
+    pool->swept_width[i] = 0.0f;
+    pool->direction[i] = (ship->facing_right) ? 1.0f : -1.0f;
+    pool->owner[i] = owner;
+    return true;
+}
+
+// Moves the last bullet into index, so the bullet now at index has not been
+// looked at yet by a loop going upwards
+static void BulletPoolRemove(BulletPool *pool, Ship *ships, int index)
+{
+    ships[pool->owner[index]].bullet_count--;
+    BulletPoolSwapRemove(pool, index);
+}
+
+// Going downwards, every bullet swapped into a hole was already checked
+static void BulletPoolRemoveFlagged(BulletPool *pool, Ship *ships)
+{
+    int group_count = (pool->count + BULLET_REMOVAL_GROUP - 1) /
+                      BULLET_REMOVAL_GROUP;
+    for (int group = group_count - 1; group >= 0; group--) {
+        if (0 == pool->removals[group]) {
+            continue;
+        }
+        int first = group * BULLET_REMOVAL_GROUP;
+        for (int i = first + BULLET_REMOVAL_GROUP - 1; i >= first; i--) {
+            if (BulletPoolIsFlagged(pool, i)) {
+                BulletPoolRemove(pool, ships, i);
+            }
+        }
+    }
+}
+
+static void BulletPoolUpdateMovement(BulletPool *pool, Ship *ships,
+                                     float deltatime)
+{
+    // Bullets leave through the side they fly towards
+    BulletPoolIntegrate(pool, BULLET_VELOCITY * deltatime, -BULLET_WIDTH,
+                        SCREEN_WIDTH);
+    BulletPoolRemoveFlagged(pool, ships);
+}
+
+Rectangle BulletPoolGetCollisionRectangle(const BulletPool *pool, int index)
+{
+    return (Rectangle){pool->swept_x[index], pool->y[index],
+                       pool->swept_width[index], BULLET_HEIGHT};
+}
+
+// Flags the bullet at index if it hits target, returns whether it did
+static bool BulletPoolCheckHit(BulletPool *pool, const Ship *ships, int index,
+                               int target, Rectangle hitbox)
+{
+    if (ships[pool->owner[index]].team == ships[target].team ||
+        BulletPoolIsFlagged(pool, index) ||
+        !CheckRectanglesOverlap(BulletPoolGetCollisionRectangle(pool, index),
+                                hitbox)) {
+        return false;
+    }
+    pool->removals[index / BULLET_REMOVAL_GROUP] |=
+        1 << index % BULLET_REMOVAL_GROUP;
+    return true;
+}
+
+// Puts every bullet into the grid, returns false if the grid could not grow
+static bool SimBuildGrid(SimState *sim)
+{
+    const BulletPool *pool = &sim->bullets;
+    SpatialGrid *grid = &sim->grid;
+    SpatialGridClear(grid);
+    if (!SpatialGridReserve(grid, pool->count)) {
+        return false;
+    }
+    for (int i = 0; i < pool->count; i++) {
+        SpatialGridAdd(grid, pool->swept_x[i], pool->y[i],
+                       pool->swept_width[i], BULLET_HEIGHT, i);
+    }
+    SpatialGridBuild(grid);
+    return true;
+}
+
+// Counts the bullets hitting each ship into damage, then removes them
+static void SimHandleCollisions(SimState *sim, int damage[SIM_MAX_SHIPS])
+{
+    BulletPool *pool = &sim->bullets;
+    memset(pool->removals, 0,
+           (pool->count + BULLET_REMOVAL_GROUP - 1) / BULLET_REMOVAL_GROUP);
+    // Building the grid costs about as much as testing every bullet against
+    // three ships, so it only pays off with more ships than that
+    bool use_grid = sim->setup.ship_count >= SIM_GRID_MIN_SHIPS &&
+                    pool->count >= SIM_GRID_MIN_BULLETS && SimBuildGrid(sim);
+
+    for (int target = 0; target < sim->setup.ship_count; target++) {
+        damage[target] = 0;
+        if (!ShipIsAlive(&sim->ships[target])) {
+            continue;
+        }
+        Rectangle hitbox = ShipGetHitbox(&sim->ships[target]);
+        int hit_count = 0;
+        if (use_grid) {
+            SpatialGridQuery query =
+                SpatialGridQueryCreate(&sim->grid, hitbox.x, hitbox.y,
+                                       hitbox.width, hitbox.height);
+            GridEntry entry;
+            while (SpatialGridQueryNext(&query, &entry)) {
+                if (BulletPoolCheckHit(pool, sim->ships, entry.index, target,
+                                       hitbox)) {
+                    sim->ships[pool->owner[entry.index]].hits++;
+                    hit_count++;
+                }
+            }
+        } else {
+            for (int i = 0; i < pool->count; i++) {
+                if (BulletPoolCheckHit(pool, sim->ships, i, target, hitbox)) {
+                    sim->ships[pool->owner[i]].hits++;
+                    hit_count++;
+                }
+            }
+        }
+        damage[target] = hit_count;
+    }
+    BulletPoolRemoveFlagged(pool, sim->ships);
+}
+
+// Team ships keep to the half of their team, the others roam everywhere
+static void ShipBoundPosition(Ship *ship, SimMode mode)
+{
+    bool left_half = SIM_MODE_TEAMS == mode && LEFT == ship->team;
+    bool right_half = SIM_MODE_TEAMS == mode && RIGHT == ship->team;
+    float left_bound = right_half ? SCREEN_WIDTH / 2.0f : 0;
+    float right_bound =
+        (left_half ? SCREEN_WIDTH / 2.0f : SCREEN_WIDTH) - SHIP_WIDTH;
+    ship->position.x = Clamp(ship->position.x, left_bound, right_bound);
+    ship->position.y = Clamp(ship->position.y, 0, SCREEN_HEIGHT - SHIP_HEIGHT);
+}
+
+static InputMask ShipGetPressed(const Ship *ship, InputMask input)
+{
+    return input & ~ship->last_input;
+}
+
+static void ShipHandleMovement(Ship *ship, SimMode mode, InputMask input,
+                               float deltatime)
+{
+    int move_y = 0;
+    if (input & INPUT_UP) {
+        move_y = -1;
+    } else if (input & INPUT_DOWN) {
+        move_y = 1;
+    }
+
+    int move_x = 0;
+    if (input & INPUT_LEFT) {
+        move_x = -1;
+    } else if (input & INPUT_RIGHT) {
+        move_x = 1;
+    }
+
+    Vector2 normalized = Vector2Normalize((Vector2){move_x, move_y});
+    Vector2 velocity = Vector2Scale(normalized, SHIP_VELOCITY * deltatime);
+    ship->position = Vector2Add(ship->position, velocity);
+
+    if (move_x || move_y) {
+        ship->last_direction = normalized;
+    }
+    if (SIM_MODE_FREE_FOR_ALL == mode && move_x) {
+        ship->facing_right = move_x > 0;
+    }
+
+    ShipBoundPosition(ship, mode);
+
+    if (ship->dash_cooldown > 0) {
+        ship->dash_cooldown -= deltatime;
+    } else if (ShipGetPressed(ship, input) & INPUT_DASH) {
+        ship->state = DASHING;
+        ship->dash_time = SHIP_DASH_DURATION;
+        ship->dashes++;
+    }
+}
+
+static void ShipHandleDash(Ship *ship, float deltatime)
+{
+    float elapsed = deltatime;
+    if (deltatime > ship->dash_time) {
+        elapsed = ship->dash_time;
+        ship->state = DEFAULT;
+        ship->dash_cooldown = SHIP_DASH_COOLDOWN;
+    } else {
+        ship->dash_time -= deltatime;
+    }
+
+    Vector2 velocity =
+        Vector2Scale(ship->last_direction, elapsed * SHIP_DASH_SPEED);
+    ship->position = Vector2Add(ship->position, velocity);
+}
+
+static void ShipUpdate(Ship *ship, SimMode mode, InputMask input,
+                       float deltatime)
+{
+    switch (ship->state) {
+    case DEFAULT:
+        ShipHandleMovement(ship, mode, input, deltatime);
+        break;
+    case DASHING:
+        ShipHandleDash(ship, deltatime);
+        break;
+    }
+}
+
+static bool ShipHandleShoot(SimState *sim, int ship_index, InputMask input)
+{
+    Ship *ship = &sim->ships[ship_index];
+    bool shooting = (ShipGetPressed(ship, input) & INPUT_SHOOT) &&
+                    ship->bullet_count < MAX_PLAYER_BULLETS &&
+                    BulletPoolAddBullet(&sim->bullets, sim->ships, ship_index);
+    if (shooting) {
+        ship->bullet_count++;
+        ship->shots++;
+    }
+    return shooting;
+}
+
+bool ShipIsAlive(const Ship *ship)
+{
+    return ship->health > 0;
+}
+
+static void ShipTakeDamage(Ship *ship, int damage)
+{
+    ship->health = (ship->health < damage) ? 0 : ship->health - damage;
+}
+
+bool SimTickRateSupported(int tick_rate)
+{
+    return 60 == tick_rate || 120 == tick_rate || 240 == tick_rate ||
+           1000 == tick_rate;
+}
+
+static uint32_t HashBytes(uint32_t hash, const void *data, size_t size)
+{
+    // FNV-1a
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t SimGetConstantsHash(void)
+{
+    const int ints[] = {
+        SIM_MAX_SHIPS,     MAX_PLAYER_BULLETS, SCREEN_WIDTH,
+        SCREEN_HEIGHT,     SHIP_WIDTH,         SHIP_HEIGHT,
+        SHIP_HITBOX_WIDTH, SHIP_HITBOX_HEIGHT, SHIP_INITIAL_HEALTH,
+        BULLET_WIDTH,      BULLET_HEIGHT};
+    const float floats[] = {SHIP_VELOCITY, SHIP_DASH_DURATION, SHIP_DASH_SPEED,
+                            SHIP_DASH_COOLDOWN, BULLET_VELOCITY};
+    uint32_t hash = 2166136261u;
+    hash = HashBytes(hash, ints, sizeof(ints));
+    hash = HashBytes(hash, floats, sizeof(floats));
+    return hash;
+}
+
+bool SimSetupValid(SimSetup setup)
+{
+    return setup.ship_count >= SIM_MIN_SHIPS &&
+           setup.ship_count <= SIM_MAX_SHIPS && setup.mode >= 0 &&
+           setup.mode < SIM_MODE_COUNT;
+}
+
+static const char *const SIM_MODE_NAMES[SIM_MODE_COUNT] = {"teams", "ffa"};
+
+bool SimModeParse(const char *name, SimMode *mode)
+{
+    for (int i = 0; i < SIM_MODE_COUNT; i++) {
+        if (0 == strcmp(name, SIM_MODE_NAMES[i])) {
+            *mode = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *SimModeGetName(SimMode mode)
+{
+    return SIM_MODE_NAMES[mode];
+}
+
+bool SimInit(SimState *sim, int bullet_capacity)
+{
+    *sim = (SimState){0};
+    if (!SpatialGridInit(&sim->grid, SCREEN_WIDTH, SCREEN_HEIGHT,
+                         SIM_GRID_CELL_SIZE)) {
+        return false;
+    }
+    if (!BulletPoolInit(&sim->bullets, bullet_capacity)) {
+        SpatialGridDeinit(&sim->grid);
+        return false;
+    }
+    return true;
+}
+
+void SimDeinit(SimState *sim)
+{
+    BulletPoolDeinit(&sim->bullets);
+    SpatialGridDeinit(&sim->grid);
+}
+
+// Teams line up down the middle of their half, the left team a half slot
+// higher than the right one, which puts a duel's ships in opposite quarters.
+// Free for all ships spread over a grid across the whole arena.
+static Vector2 SimGetSpawnCenter(SimSetup setup, int index)
+{
+    if (SIM_MODE_TEAMS == setup.mode) {
+        int team = index % 2;
+        int member_count = (setup.ship_count + 1 - team) / 2;
+        float slot = (index / 2 + (team ? 0.75f : 0.25f)) / member_count;
+        return (Vector2){SCREEN_WIDTH * (team ? 0.75f : 0.25f),
+                         SCREEN_HEIGHT * slot};
+    }
+
+    int columns = 1;
+    while (columns * columns < setup.ship_count) {
+        columns++;
+    }
+    int rows = (setup.ship_count + columns - 1) / columns;
+    return (Vector2){SCREEN_WIDTH * (index % columns + 0.5f) / columns,
+                     SCREEN_HEIGHT * (index / columns + 0.5f) / rows};
+}
+
+void SimReset(SimState *sim, SimSetup setup, uint32_t seed)
+{
+    assert(SimSetupValid(setup));
+    sim->setup = setup;
+    for (int i = 0; i < setup.ship_count; i++) {
+        Vector2 center = SimGetSpawnCenter(setup, i);
+        // Free for all ships start facing the middle of the arena
+        bool facing_right = (SIM_MODE_TEAMS == setup.mode)
+                                ? 0 == i % 2
+                                : center.x < SCREEN_WIDTH / 2.0f ||
+                                      (center.x == SCREEN_WIDTH / 2.0f &&
+                                       0 == i % 2);
+        Ship *ship = &sim->ships[i];
+        *ship = (Ship){
+            .position = {center.x - SHIP_WIDTH / 2.0f,
+                         center.y - SHIP_HEIGHT / 2.0f},
+            .facing_right = facing_right,
+            .team = (SIM_MODE_TEAMS == setup.mode) ? i % 2 : i,
+            .bullet_count = 0,
+            .health = SHIP_INITIAL_HEALTH,
+            .state = DEFAULT,
+            .last_direction = {0.0f, facing_right ? 1.0f : -1.0f}};
+        ShipBoundPosition(ship, setup.mode);
+        ship->last_position = ship->position;
+    }
+    for (int i = setup.ship_count; i < SIM_MAX_SHIPS; i++) {
+        sim->ships[i] = (Ship){0};
+    }
+
+    sim->bullets.count = 0;
+    sim->winner = NONE;
+    sim->tick = 0;
+    sim->seed = seed;
+}
+
+// Keep snapshots small so rollback can take one every tick
+_Static_assert(sizeof(SimSnapshot) <= 2048,
+               "SimState grew too big to snapshot");
+
+// Copies everything but where source's bullets are stored and its grid
+static void SimCopy(SimState *destination, const SimState *source)
+{
+    BulletPool bullets = destination->bullets;
+    SpatialGrid grid = destination->grid;
+    memcpy(destination, source, sizeof(*destination));
+    destination->bullets = bullets;
+    destination->grid = grid;
+    BulletPoolCopy(&destination->bullets, &source->bullets);
+}
+
+void SimSaveSnapshot(const SimState *sim, SimSnapshot *snapshot)
+{
+    SimCopy(snapshot, sim);
+}
+
+void SimLoadSnapshot(SimState *sim, const SimSnapshot *snapshot)
+{
+    SimCopy(sim, snapshot);
+}
+
+// The team every ship still alive is on, DRAW if none is left and NONE if
+// ships of several teams are
+static Winner SimFindWinner(const SimState *sim)
+{
+    Winner standing = DRAW;
+    for (int i = 0; i < sim->setup.ship_count; i++) {
+        const Ship *ship = &sim->ships[i];
+        if (!ShipIsAlive(ship) || (int)standing == ship->team) {
+            continue;
+        }
+        if (DRAW != standing) {
+            return NONE;
+        }
+        standing = ship->team;
+    }
+    return standing;
+}
+
+SimEvents SimStep(SimState *sim, const InputMask inputs[SIM_MAX_SHIPS],
+                  float deltatime)
+{
+    PROFILE_BEGIN(SimStep);
+    const int ship_count = sim->setup.ship_count;
+    SimEvents events = 0;
+
+    for (int i = 0; i < ship_count; i++) {
+        sim->ships[i].last_position = sim->ships[i].position;
+    }
+
+    PROFILE_BEGIN(BulletPoolUpdateMovement);
+    BulletPoolUpdateMovement(&sim->bullets, sim->ships, deltatime);
+    PROFILE_END(BulletPoolUpdateMovement);
+
+    for (int i = 0; i < ship_count; i++) {
+        Ship *ship = &sim->ships[i];
+        if (ShipIsAlive(ship)) {
+            PROFILE_BEGIN(ShipUpdate);
+            ShipUpdate(ship, sim->setup.mode, inputs[i], deltatime);
+            PROFILE_END(ShipUpdate);
+            if (ShipHandleShoot(sim, i, inputs[i])) {
+                events |= SIM_EVENT_SHOOT;
+            }
+        }
+        ship->last_input = inputs[i];
+    }
+
+    int damage[SIM_MAX_SHIPS];
+    PROFILE_BEGIN(SimHandleCollisions);
+    SimHandleCollisions(sim, damage);
+    PROFILE_END(SimHandleCollisions);
+    for (int i = 0; i < ship_count; i++) {
+        if (damage[i]) {
+            events |= SIM_EVENT_HIT;
+        }
+        ShipTakeDamage(&sim->ships[i], damage[i]);
+    }
+
+    sim->winner = SimFindWinner(sim);
+    if (NONE != sim->winner) {
+        events |= SIM_EVENT_WIN;
+    }
+
+    sim->tick++;
+    PROFILE_END(SimStep);
+    return events;
+}
@@ -0,0 +1,174 @@
+#ifndef SPACEWAR_SIM_H
+#define SPACEWAR_SIM_H
+
+// Headless match simulation. Nothing in here touches the window, the GPU or
+// the audio device: the front end feeds per-tick inputs in and reads state
+// and events back out.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "raymath.h"
+#include "spacewar_bullets.h"
+#include "spacewar_grid.h"
+
+#if !defined(RL_RECTANGLE_TYPE)
+typedef struct Rectangle {
+    float x;
+    float y;
+    float width;
+    float height;
+} Rectangle;
+#define RL_RECTANGLE_TYPE
+#endif
+
+#define SIM_MIN_SHIPS 2
+#define SIM_MAX_SHIPS 16
+#define SIM_DEFAULT_TICK_RATE 120
+#define MAX_PLAYER_BULLETS 3
+#define MAX_POOL_BULLETS (MAX_PLAYER_BULLETS * SIM_MAX_SHIPS)
+#define SIM_DEFAULT_BULLET_CAPACITY MAX_POOL_BULLETS
+// Side of a collision grid cell in pixels
+#define SIM_GRID_CELL_SIZE 32
+// With fewer ships or bullets than this every bullet is tested against every
+// ship directly, see bench.c
+#define SIM_GRID_MIN_SHIPS 4
+#define SIM_GRID_MIN_BULLETS 16
+
+static const int SCREEN_WIDTH = 480;
+static const int SCREEN_HEIGHT = 270;
+
+static const int SHIP_WIDTH = 24;
+static const int SHIP_HEIGHT = 26;
+static const float SHIP_VELOCITY = 180.0f;
+static const int SHIP_HITBOX_WIDTH = 14;
+static const int SHIP_HITBOX_HEIGHT = 20;
+static const int SHIP_INITIAL_HEALTH = 3;
+static const float SHIP_DASH_DURATION = 0.07f;
+static const float SHIP_DASH_SPEED = 1000.0f;
+static const float SHIP_DASH_COOLDOWN = 5.0f;
+
+static const int BULLET_WIDTH = 12;
+static const int BULLET_HEIGHT = 1;
+static const float BULLET_VELOCITY = 600.0f;
+
+// One player's controls for a single tick, one bit per held button. Shooting
+// and dashing trigger on the tick their bit goes from 0 to 1.
+typedef uint8_t InputMask;
+
+enum {
+    INPUT_UP = 1 << 0,
+    INPUT_DOWN = 1 << 1,
+    INPUT_LEFT = 1 << 2,
+    INPUT_RIGHT = 1 << 3,
+    INPUT_SHOOT = 1 << 4,
+    INPUT_DASH = 1 << 5,
+};
+
+#define INPUT_MASK_BITS 6
+
+typedef struct {
+    Vector2 position;
+    // Position at the start of the last tick, for render interpolation
+    Vector2 last_position;
+    // Bullets fly the way the ship faces and hit ships of other teams only
+    bool facing_right;
+    int team;
+    int bullet_count;
+    int health;
+    Vector2 last_direction;
+    float dash_time;
+    float dash_cooldown;
+    enum { DEFAULT, DASHING } state;
+    // Input of the previous tick, to tell presses apart from held buttons
+    InputMask last_input;
+    // Counted over the match for balance testing
+    int shots;
+    int hits;
+    int dashes;
+} Ship;
+
+// The team left standing, NONE while the match runs or DRAW when the last
+// ships went down on the same tick. Team games are LEFT against RIGHT.
+typedef enum {
+    DRAW = -2,
+    NONE = -1,
+    LEFT = 0,
+    RIGHT = 1,
+} Winner;
+
+typedef enum {
+    // Even ships play on the left half and odd ones on the right half
+    SIM_MODE_TEAMS,
+    // Every ship for itself over the whole arena, turning where it moves
+    SIM_MODE_FREE_FOR_ALL,
+    SIM_MODE_COUNT,
+} SimMode;
+
+typedef struct {
+    int ship_count;
+    SimMode mode;
+} SimSetup;
+
+static const SimSetup SIM_DUEL_SETUP = {2, SIM_MODE_TEAMS};
+
+typedef struct {
+    SimSetup setup;
+    Ship ships[SIM_MAX_SHIPS];
+    BulletPool bullets;
+    Winner winner;
+    uint32_t tick;
+    // Picked per match; anything random, like bot decisions, derives from it
+    uint32_t seed;
+    // Scratch for finding collisions, rebuilt every tick and never copied
+    SpatialGrid grid;
+} SimState;
+
+// The whole match, a SimState with bullet storage and a collision grid of its
+// own. Both the bullet arrays and the grid's arrays are heap pointers,
+// so a plain assignment or memcpy would share them and free them twice. Save
+// and load snapshots with SimSaveSnapshot and SimLoadSnapshot only, which
+// copy a couple of kilobytes plus the live bullets and leave the grid alone.
+typedef SimState SimSnapshot;
+
+// Things that happened during a tick, for the front end to play sounds on
+typedef enum {
+    SIM_EVENT_SHOOT = 1 << 0,
+    SIM_EVENT_HIT = 1 << 1,
+    SIM_EVENT_WIN = 1 << 2,
+} SimEvent;
+
+typedef unsigned int SimEvents;
+
+// The simulation is meant to be stepped at a fixed rate, one of 60, 120, 240
+// or 1000 ticks per second, so results do not depend on the frame rate
+bool SimTickRateSupported(int tick_rate);
+
+// Hash of every gameplay constant, so a replay recorded with different rules
+// is rejected instead of desyncing
+uint32_t SimGetConstantsHash(void);
+
+// Between SIM_MIN_SHIPS and SIM_MAX_SHIPS ships in a known mode
+bool SimSetupValid(SimSetup setup);
+bool SimModeParse(const char *name, SimMode *mode);
+const char *SimModeGetName(SimMode mode);
+
+// Allocates room for bullet_capacity bullets, shots past it are dropped.
+// Snapshots are set up the same way and must have the same capacity.
+bool SimInit(SimState *sim, int bullet_capacity);
+void SimDeinit(SimState *sim);
+void SimReset(SimState *sim, SimSetup setup, uint32_t seed);
+// inputs holds one mask per ship of the setup
+SimEvents SimStep(SimState *sim, const InputMask inputs[SIM_MAX_SHIPS],
+                  float deltatime);
+
+void SimSaveSnapshot(const SimState *sim, SimSnapshot *snapshot);
+void SimLoadSnapshot(SimState *sim, const SimSnapshot *snapshot);
+
+Rectangle ShipGetHitbox(const Ship *ship);
+// Ships out of health stay where they went down but no longer play
+bool ShipIsAlive(const Ship *ship);
+// Area the bullet at index swept over during the last tick
+Rectangle BulletPoolGetCollisionRectangle(const BulletPool *pool, int index);
+
+#endif /* ifndef SPACEWAR_SIM_H */
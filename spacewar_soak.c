@@ -0,0 +1,132 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#define _DEFAULT_SOURCE
+#include <unistd.h>
+#endif
+
+#include "spacewar_soak.h"
+
+// Samples at the start left out of the check while caches fill up
+#define SOAK_WARMUP_PERCENT 10
+// Parts the rest of the run is split into, a metric keeps growing if the
+// mean of every part is above the one before
+#define SOAK_CHECK_PARTS 4
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    double scale;
+    // Growth from the first part to the last that is still only noise
+    double tolerance;
+    double relative_tolerance;
+} SoakMetricInfo;
+
+static const SoakMetricInfo SOAK_METRICS[SOAK_METRIC_COUNT] = {
+    {"resident memory", "MiB", 1.0 / (1024 * 1024), 256 * 1024, 0.01},
+    {"live textures", "", 1.0, 0.5, 0.0},
+    {"live sounds", "", 1.0, 0.5, 0.0},
+    {"frame time", "ms", 1e3, 50e-6, 0.05},
+};
+
+const char *SoakMetricGetName(SoakMetric metric)
+{
+    return SOAK_METRICS[metric].name;
+}
+
+void SoakLogInit(SoakLog *log)
+{
+    log->count = 0;
+    log->stride = 1;
+    log->skipped = 0;
+}
+
+void SoakLogAdd(SoakLog *log, const SoakSample *sample)
+{
+    if (++log->skipped < log->stride) {
+        return;
+    }
+    log->skipped = 0;
+    if (SOAK_MAX_SAMPLES == log->count) {
+        // Keep every other sample and from now on every other new one
+        for (int i = 0; i < SOAK_MAX_SAMPLES / 2; i++) {
+            log->samples[i] = log->samples[2 * i + 1];
+        }
+        log->count = SOAK_MAX_SAMPLES / 2;
+        log->stride *= 2;
+    }
+    log->samples[log->count++] = *sample;
+}
+
+static double SoakLogGetMean(const SoakLog *log, int first, int end,
+                             SoakMetric metric)
+{
+    double sum = 0.0;
+    for (int i = first; i < end; i++) {
+        sum += log->samples[i].values[metric];
+    }
+    return sum / (end - first);
+}
+
+bool SoakLogCheck(const SoakLog *log, FILE *report)
+{
+    int first = log->count * SOAK_WARMUP_PERCENT / 100;
+    int checked = log->count - first;
+    if (checked < SOAK_CHECK_PARTS * 2) {
+        fprintf(report, "Only %d samples, too few to tell growth apart\n",
+                log->count);
+        return true;
+    }
+
+    fprintf(report, "Soak over cycles %d to %d, means of %d parts:\n",
+            log->samples[first].cycle, log->samples[log->count - 1].cycle,
+            SOAK_CHECK_PARTS);
+    bool ok = true;
+    for (int metric = 0; metric < SOAK_METRIC_COUNT; metric++) {
+        const SoakMetricInfo *info = &SOAK_METRICS[metric];
+        double means[SOAK_CHECK_PARTS];
+        bool rising = true;
+        fprintf(report, "  %-16s", info->name);
+        for (int part = 0; part < SOAK_CHECK_PARTS; part++) {
+            int part_first = first + checked * part / SOAK_CHECK_PARTS;
+            int part_end = first + checked * (part + 1) / SOAK_CHECK_PARTS;
+            means[part] = SoakLogGetMean(log, part_first, part_end, metric);
+            rising = rising && (0 == part || means[part] > means[part - 1]);
+            fprintf(report, " %10.2f", means[part] * info->scale);
+        }
+        double growth = means[SOAK_CHECK_PARTS - 1] - means[0];
+        bool growing =
+            rising && growth > info->tolerance &&
+            growth > means[0] * info->relative_tolerance;
+        fprintf(report, " %-3s %s\n", info->unit,
+                growing ? "KEEPS GROWING" : "ok");
+        ok = ok && !growing;
+    }
+    return ok;
+}
+
+size_t SoakGetResidentBytes(void)
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                              sizeof(counters))) {
+        return 0;
+    }
+    return counters.WorkingSetSize;
+#else
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (NULL == file) {
+        return 0;
+    }
+    unsigned long size;
+    unsigned long resident = 0;
+    if (2 != fscanf(file, "%lu %lu", &size, &resident)) {
+        resident = 0;
+    }
+    fclose(file);
+    return (size_t)resident * sysconf(_SC_PAGESIZE);
+#endif
+}
@@ -0,0 +1,49 @@
+#ifndef SPACEWAR_SOAK_H
+#define SPACEWAR_SOAK_H
+
+// Samples taken while the game plays itself for hours, and the check that
+// none of them keeps growing, to catch leaks before they take a long running
+// machine down.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Samples kept, older ones are thinned out to make room so the log always
+// spans the whole run
+#define SOAK_MAX_SAMPLES 1024
+
+typedef enum {
+    SOAK_METRIC_RSS,
+    SOAK_METRIC_TEXTURES,
+    SOAK_METRIC_SOUNDS,
+    // Mean seconds per frame since the last sample
+    SOAK_METRIC_FRAME_TIME,
+    SOAK_METRIC_COUNT,
+} SoakMetric;
+
+typedef struct {
+    int cycle;
+    double values[SOAK_METRIC_COUNT];
+} SoakSample;
+
+typedef struct {
+    SoakSample samples[SOAK_MAX_SAMPLES];
+    int count;
+    // Only every stride-th sample added is kept
+    int stride;
+    int skipped;
+} SoakLog;
+
+const char *SoakMetricGetName(SoakMetric metric);
+
+void SoakLogInit(SoakLog *log);
+void SoakLogAdd(SoakLog *log, const SoakSample *sample);
+// Writes how each metric changed over the run to report, returns false if
+// any of them kept growing
+bool SoakLogCheck(const SoakLog *log, FILE *report);
+
+// Resident set size of this process in bytes, 0 where unknown
+size_t SoakGetResidentBytes(void);
+
+#endif /* ifndef SPACEWAR_SOAK_H */